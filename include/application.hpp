@@ -20,67 +20,593 @@
 
 #pragma once
 
-#include <gl/gl3w.h>
-#include <glfw/glfw3.h>
+#include <GL/gl3w.h>
+#include <GLFW/glfw3.h>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+#include "capture.hpp"
+#include "metrics.hpp"
+#include "pacing.hpp"
+#include "scene.hpp"
+#include "snapshot.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+#include <array>
+#include <bit>
 #include <chrono>
 #include <cstdint>
 #include <string>
 #include <atomic>
+#include <exception>
 #include <mutex>
+#include <optional>
+#include <thread>
 #include <vector>
 
 // constants
-#define SPH_NUM_PARTICLES 20000
-
 #define SPH_PARTICLE_RADIUS 0.005f
+#define SPH_PARTICLE_MASS 0.02f
+// gives a particle on the 3d lattice the same density as on the 2d one
+#define SPH_PARTICLE_MASS_3D 0.0124f
+#define SPH_SMOOTHING_LENGTH (4 * SPH_PARTICLE_RADIUS)
+
+#define SPH_TIME_STEP 0.0001f
+// pcisph has no stiffness limit, the step is bounded by the fall speed relative to the smoothing length instead
+#define SPH_PCISPH_TIME_STEP 0.0002f
+#define SPH_PCISPH_MAX_ITERATIONS 8
+// pbf trades accuracy for large steps
+#define SPH_PBF_TIME_STEP 0.0005f
+#define SPH_PBF_ITERATIONS 4
+// constraint force mixing relative to the constraint gradient of a particle with a full neighborhood
+#define SPH_PBF_RELAXATION 0.01f
+
+// cells per side of the neighbor search grid over the [-1, 1] domain, cells are as large as the smoothing length.
+// the 3d grid has the same number of cells along z
+#define SPH_GRID_RESOLUTION 100
 
 #define SPH_WORK_GROUP_SIZE 128
-// work group count is the ceiling of particle count divided by work group size
-#define SPH_NUM_WORK_GROUPS ((SPH_NUM_PARTICLES + SPH_WORK_GROUP_SIZE - 1) / SPH_WORK_GROUP_SIZE)
+
+// sleeping cells, a cell whose particles stay below both thresholds for the given number of steps is skipped by the
+// sph kernels until a neighbor cell wakes up. the values are repeated in the sleep_*.comp shaders
+#define SPH_SLEEP_SPEED 0.05f
+#define SPH_SLEEP_ACCELERATION 500.f
+#define SPH_SLEEP_STEPS 200
+
+// texels per side of the signed distance field covering the [-1, 1] domain
+#define SPH_SDF_RESOLUTION 512
+
+// screen-space surface, particles are splatted as spheres of this many particle radii
+#define SPH_SURFACE_SPHERE_RADIUS 2.f
+// boundary contour, nodes per side of the density grid when -contour is given without a value
+#define SPH_CONTOUR_RESOLUTION 256
+// camera zoom limits, 1 shows the whole domain
+#define SPH_ZOOM_MIN 0.5f
+#define SPH_ZOOM_MAX 256.f
+// a slot of the render frame buffer starts with the dispatch and draw commands in the layout of simulation_state,
+// the positions follow at this offset
+#define SPH_RENDER_FRAME_HEADER 256
 
 namespace sph
 {
 
+// mirrors simulation_state_block (binding 5) in the compute shaders.
+// compaction and emitters only write compacted_count and emitted_count, update_indirect.comp turns them into the new
+// particle_count and derives the indirect commands from it.
+struct simulation_state
+{
+    // DispatchIndirectCommand, work group count is the ceiling of particle count divided by work group size
+    uint32_t num_work_groups_x;
+    uint32_t num_work_groups_y;
+    uint32_t num_work_groups_z;
+    // DrawArraysIndirectCommand
+    uint32_t draw_count;
+    uint32_t draw_instance_count;
+    uint32_t draw_first;
+    uint32_t draw_base_instance;
+    // number of live particles
+    uint32_t particle_count;
+    // particle count after sinks removed particles this step
+    uint32_t compacted_count;
+    // particles appended by emitters this step, may exceed the free capacity
+    uint32_t emitted_count;
+    // size of every array in the packed particle buffer
+    uint32_t particle_capacity;
+    uint32_t step_number;
+    // DispatchIndirectCommand of the pcisph iterations, zeroed by pcisph_check.comp once the density error is small enough
+    uint32_t solver_work_groups_x;
+    uint32_t solver_work_groups_y;
+    uint32_t solver_work_groups_z;
+    uint32_t solver_iteration;
+    // float bits of the largest density error of the current iteration
+    uint32_t max_density_error;
+    // DispatchIndirectCommand over the particles of awake cells, built by sleep_gather.comp
+    uint32_t active_work_groups_x;
+    uint32_t active_work_groups_y;
+    uint32_t active_work_groups_z;
+    uint32_t active_particle_count;
+    uint32_t awake_cell_count;
+};
+
+// mirrors contour_state_block (binding 24) in the contour shaders
+struct contour_state
+{
+    // DrawArraysIndirectCommand of the particles the contour is traced from, copied from the drawn frame
+    uint32_t source_count;
+    uint32_t source_instance_count;
+    uint32_t source_first;
+    uint32_t source_base_instance;
+    // DrawArraysIndirectCommand of the segments, contour_extract.comp counts their vertices
+    uint32_t vertex_count;
+    uint32_t instance_count;
+    uint32_t first_vertex;
+    uint32_t base_instance;
+};
+
+// mirrors view_block (uniform binding 1) in the render shaders, applied after the fixed projection
+struct alignas(16) view_parameters
+{
+    // normalized device coordinates at the center of the window
+    glm::vec2 center;
+    float zoom;
+};
+
+// mirrors cull_state_block (binding 30) in cull.comp
+struct cull_state
+{
+    // DrawArraysIndirectCommand of the drawn frame
+    uint32_t source_count;
+    uint32_t source_instance_count;
+    uint32_t source_first;
+    uint32_t source_base_instance;
+    // DrawArraysIndirectCommand over the visible particle list
+    uint32_t draw_count;
+    uint32_t draw_instance_count;
+    uint32_t draw_first;
+    uint32_t draw_base_instance;
+};
+
+// mirrors simulation_parameters_block (uniform binding 0) in the compute shaders, std140 layout.
+// values that only change numbers live here so they can change between steps, values that select code paths or size
+// buffers stay specialization constants and defines.
+struct alignas(16) simulation_parameters
+{
+    glm::vec4 gravity;
+    // walls of the fluid domain, within the [-1, 1] box
+    glm::vec4 domain_min;
+    glm::vec4 domain_max;
+    float time_step;
+    float particle_mass;
+    float rest_density;
+    float stiffness;
+    float viscosity;
+    // derived from the values above by set_parameters
+    float pcisph_delta;
+    float lattice_rest_density;
+    float pbf_relaxation;
+};
+
+// spreads one parameter linearly over the simulations of an ensemble, first to last member
+struct parameter_sweep
+{
+    // stiffness, viscosity, rest_density, mass or gravity (the y component)
+    std::string parameter;
+    float first;
+    float last;
+};
+
+enum class render_style
+{
+    // a point per particle
+    points,
+    // screen-space fluid surface from smoothed sphere splats, see render_surface
+    surface,
+    // particle count and mean speed per pixel, see render_density
+    density,
+};
+
+// particle attribute the point renderer colors by, see particle.vert
+enum class color_attribute
+{
+    none,
+    speed,
+    density,
+    pressure,
+};
+
+enum class color_map
+{
+    viridis,
+    // blue through white to red
+    diverging,
+    grayscale,
+};
+
+// command line choices, see parse_options
+struct application_options
+{
+    // scene file to load, the built-in scene selected by scene_id and three_dimensional if empty
+    std::string scene_path;
+    int64_t scene_id = 0;
+    bool three_dimensional = false;
+    // overrides the solver of the scene
+    std::optional<solver_type> solver;
+    // skip the particles of settled cells, sph solver only
+    bool sleeping = false;
+    // independent copies of the scene run side by side in the same dispatches
+    uint32_t ensemble_size = 1;
+    std::optional<parameter_sweep> sweep;
+    // where and how often the frame statistics are shown
+    stats_output stats = stats_output::title;
+    float stats_interval = 0.5f;
+    // chrome trace json of the cpu and gpu spans, written at exit and when T is pressed. tracing is off if empty
+    std::string trace_path;
+    // prometheus metrics, rewritten as a text file and/or served on 127.0.0.1:port. off if empty and 0
+    std::string metrics_path;
+    uint16_t metrics_port = 0;
+    // step on a thread of its own instead of in lockstep with event handling, rendering and the buffer swap
+    bool simulation_thread = true;
+    // records every frame as ppm images (a %d or %0Nd in the path numbers them) or a raw rgb24 stream (.rgb, .raw).
+    // capture runs in lockstep, so the frames are steps_per_frame steps apart
+    std::string capture_path;
+    uint32_t steps_per_frame = 1;
+    // particle snapshots every snapshot_interval steps, see snapshot.hpp for the formats. off if empty. a snapshot the
+    // writers cannot take yet is dropped, or with snapshot_delay taken on a later step
+    std::string snapshot_path;
+    uint32_t snapshot_interval = 100;
+    bool snapshot_delay = false;
+    // hidden window and no buffer swaps, for batch runs
+    bool headless = false;
+    // no window and no drawing, only step, reset, export_particles and the accessors. the context comes from EGL without
+    // a display server when built with SPH_EGL, from a hidden glfw window otherwise
+    bool windowless = false;
+    // maps the packed particle buffer persistently so the host reads and writes the particles in place, see
+    // application::mapped_particles. lockstep only
+    bool mapped_particles = false;
+    // prepended to the shader file names, the working directory if empty
+    std::string shader_directory;
+    // stop after this many frames, 0 runs until the window is closed
+    uint64_t frame_limit = 0;
+    // frames per second shown. in lockstep the time between them goes to steps, at least steps_per_frame per frame.
+    // 0 draws after every steps_per_frame steps as fast as possible. capture and headless runs are never paced
+    float present_rate = 60;
+    render_style style = render_style::points;
+    // resolution of the surface splats relative to the window and radius of the smoothing filter in their pixels
+    float surface_scale = 0.5f;
+    uint32_t surface_filter_radius = 6;
+    // boundary line of the fluid from marching squares over a density grid with this many nodes per side, redone every
+    // contour_interval steps. off if 0, 2d only
+    uint32_t contour_resolution = 0;
+    uint32_t contour_interval = 10;
+    // point colors, the range is picked from the rest density and the stiffness if min and max are equal
+    color_attribute coloring = color_attribute::none;
+    color_map colormap = color_map::viridis;
+    float color_min = 0;
+    float color_max = 0;
+};
+
+// reads the flags of the sph executable, throws std::runtime_error on a malformed one
+application_options parse_options(int argc, char** argv);
+
+// part of a buffer bound to an indexed binding point
+struct buffer_range
+{
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+};
+
+// constant_id and value (as bit pattern) of a SPIR-V specialization constant
+struct specialization_constant
+{
+    GLuint index;
+    GLuint value;
+};
+
+// one entry per array in the packed particle buffer, mirrors attribute_layout_block (binding 10)
+struct particle_attribute
+{
+    // offset of the array from the start of the packed buffer in 32-bit words
+    uint32_t offset;
+    // 32-bit words per particle
+    uint32_t size;
+};
+
+// completed state handed from the simulation thread to the render thread, see hand_off_frame
+struct render_frame
+{
+    // signaled once the simulation has copied the state into the slot
+    GLsync ready;
+    // signaled once the last draw from the slot has finished
+    GLsync released;
+};
+
 class application
 {
 public:
     application();
-    explicit application(int64_t scene_id);
+    explicit application(const application_options& options);
     application(const application&) = delete;
     ~application();
     void run();
+    // takes effect from the next step, no shader is rebuilt. the derived fields are recomputed
+    void set_parameters(const simulation_parameters& new_parameters);
+    const simulation_parameters& parameters() const;
+    // ensemble mode only, the parameters of one simulation
+    void set_member_parameters(uint32_t member, const simulation_parameters& new_parameters);
+    const simulation_parameters& member_parameters(uint32_t member) const;
+
+    // library use, see python/sph_module.cpp. lockstep only, the steps run on the calling thread without rendering or
+    // event handling and are not waited for
+    void step(uint32_t count = 1);
+    // back to the particles of the scene at step 0, the parameters are kept
+    void reset();
+    // waits for the steps issued so far
+    void synchronize();
+    uint64_t step_count() const;
+    double simulated_time() const;
+    // read back from the gpu, waits for the steps issued so far
+    uint32_t particle_count() const;
+    // rows of every array in the packed particle buffer
+    uint32_t capacity() const;
+    uint32_t dimensions() const;
+    // the packed particle buffer with the arrays of attributes(), nullptr without application_options::mapped_particles.
+    // the mapping is coherent, it shows the state after the last synchronize and writes take effect from the next step
+    void* mapped_particles() const;
+    const std::vector<particle_attribute>& attributes() const;
+    // writes the current particles in the format of the extension, see snapshot_exporter::start. the step number is
+    // added to the file name as with -snapshot. waits until the file is written
+    void export_particles(const std::string& path);
 
 private:
     void initialize_window();
     void initialize_opengl();
+    void initialize_rendering();
+    void spawn_fluid_blocks();
+    void create_signed_distance_field();
     void destroy_window();
     void destroy_opengl();
-    GLuint compile_shader(std::string path_to_file, GLenum shader_type);
+    GLuint compile_shader(std::string path_to_file, GLenum shader_type, const std::vector<specialization_constant>& constants = {});
+    GLuint create_compute_program(std::string path_to_file, const std::vector<specialization_constant>& constants = {});
+    // both stages are specialized with the same list, each only takes the constants it declares
+    GLuint create_graphics_program(const std::string& vertex_file, const std::string& fragment_file, const std::vector<specialization_constant>& constants = {});
+    void compute_prototype_parameters(float time_step, float mass, float& pcisph_delta, float& rest_density, float& constraint_gradient);
+    void derive_parameters(simulation_parameters& derived_parameters);
     void check_program_linked(GLuint shader_program_handle);
     void main_loop();
+    void simulation_loop();
+    void present_frame();
+    void hand_off_frame();
+    void throttle_frames();
+    const char* solver_name() const;
     void run_simulation();
+    void build_grid();
+    void update_sleeping_cells();
+    void solve_pressure();
+    void run_position_based_fluids();
+    void compact_particles();
+    void run_prefix_sum(const buffer_range& scan, const buffer_range& block_sum, uint32_t num_work_groups);
+    void emit_particles();
+    void update_indirect_commands();
+    simulation_state initial_state() const;
     void render();
+    void initialize_surface();
+    void render_surface(GLintptr draw_command);
+    void initialize_contour();
+    void update_contour(GLintptr frame_command);
+    void initialize_density();
+    void cull_particles(GLintptr frame_command);
+    // the cursor in normalized device coordinates
+    glm::vec2 cursor_position() const;
+    void render_density(GLintptr frame_command);
+    void publish_stats();
+    void write_trace();
+    void update_metrics();
+    void export_snapshot();
+    snapshot_source particle_source() const;
 
     GLFWwindow* window = nullptr;
     uint64_t window_height = 1000;
     uint64_t window_length = 1000;
 
     std::atomic_uint64_t frame_number = 1;
+    // sum of the time steps taken, read by the metrics and the performance log like frame_number
+    std::atomic<double> simulated_seconds = 0;
+    // presented or captured frames, a frame is steps_per_frame steps in lockstep
+    uint64_t rendered_frames = 0;
+    uint32_t steps_per_frame = 1;
+    uint64_t frame_limit = 0;
+    bool headless = false;
+    bool windowless = false;
+    // display and context of a windowless application built with SPH_EGL
+    void* egl_display = nullptr;
+    void* egl_context = nullptr;
+    std::string shader_directory;
+    frame_capture capture;
+    std::string capture_path;
+    // presentation schedule, fed with the gpu times of the frame stats
+    frame_pacer pacer;
+    GLsync frame_fence = nullptr;
+    // size of the window framebuffer and of the surface splat target
+    int framebuffer_width = 0;
+    int framebuffer_height = 0;
+    render_style style = render_style::points;
+    float surface_scale = 0.5f;
+    uint32_t surface_filter_radius = 6;
+    int surface_width = 0;
+    int surface_height = 0;
+    uint32_t contour_resolution = 0;
+    uint32_t contour_interval = 10;
+    color_attribute coloring = color_attribute::none;
+    color_map colormap = color_map::viridis;
+    float color_min = 0;
+    float color_max = 0;
+    // camera, moved by the input callbacks on the main thread and uploaded by render once changed
+    view_parameters view { glm::vec2(0, 0), 1 };
+    bool view_changed = true;
+    bool panning = false;
+    glm::vec2 pan_cursor { 0, 0 };
+    // step of the last contour update, 0 before the first
+    uint64_t contour_step = 0;
 
-    bool paused = false;
+    std::atomic_bool paused = false;
+    // performance warnings of the OpenGL debug output, both contexts count here
+    std::atomic_uint64_t gl_performance_messages = 0;
 
-    int64_t scene_id = 0;
+    // simulation thread with its own context sharing the objects of the window context. a hidden window carries it
+    bool use_simulation_thread = true;
+    GLFWwindow* simulation_window = nullptr;
+    std::thread simulation_thread;
+    std::atomic_bool simulation_running = false;
+    std::exception_ptr simulation_error;
+    // triple buffered positions and draw commands. the simulation writes one slot, the render thread draws
+    // another and the third holds the latest completed state. the indices are swapped under the mutex
+    std::array<render_frame, 3> render_frames {};
+    std::mutex render_frame_mutex;
+    uint32_t written_frame = 0;
+    uint32_t latest_frame = 1;
+    uint32_t presented_frame = 2;
+    bool latest_frame_fresh = false;
+    GLsizeiptr render_frame_stride = 0;
+    // one more particle array behind the positions of a slot, the velocities for the density renderer or the colored
+    // attribute. offset 0 if the slots only carry positions
+    GLintptr render_frame_attribute_offset = 0;
+    GLintptr render_frame_attribute_source = 0;
+    GLsizeiptr render_frame_attribute_size = 0;
+    // ssbo binding the attribute is pulled from by the render shaders, -1 if none
+    GLint render_frame_attribute_binding = -1;
+    // the render thread has its own timer queries, the simulation thread formats stats under the mutex
+    frame_stats render_stats;
+    std::mutex stats_mutex;
+
+    // frame statistics, published a few times per second instead of every frame
+    frame_stats stats;
+    stats_output stats_target = stats_output::title;
+    float stats_interval = 0.5f;
+    std::array<char, 512> title_text {};
+    // timeline of the frames, see trace.hpp
+    trace_recorder tracer;
+    std::string trace_path;
+    // metrics, the simulation state is copied to a mapped buffer and read once its fence signals
+    metrics_exporter metrics;
+    std::string metrics_path;
+    uint16_t metrics_port = 0;
+    uint32_t state_readback_buffer_handle = 0;
+    const simulation_state* state_readback = nullptr;
+    GLsync state_readback_fence = nullptr;
+    std::chrono::steady_clock::time_point metrics_start;
+    std::chrono::steady_clock::time_point next_state_readback;
+    uint64_t particle_buffer_bytes = 0;
+    // of the arrays in the packed particle buffer
+    std::vector<particle_attribute> particle_attributes;
+    // snapshots of the particles, written by the exporter threads
+    snapshot_exporter snapshots;
+    std::string snapshot_path;
+    uint32_t snapshot_interval = 100;
+    bool snapshot_delay = false;
+    uint64_t next_snapshot_step = 0;
+    // character codes of the overlay text, as read by overlay.frag
+    std::array<uint32_t, SPH_STATS_OVERLAY_LINES * SPH_STATS_OVERLAY_COLUMNS> overlay_characters {};
+
+    solver_type solver = solver_type::sph;
+    float time_step = SPH_TIME_STEP;
+    simulation_parameters current_parameters {};
+    bool sleeping = false;
+    // runs the *.3d.spv shader variants on vec4 particle storage
+    bool three_dimensional = false;
+
+    // scene
+    scene_description scene;
+    uint32_t particle_capacity = 0;
+
+    // ensemble, the simulations follow each other in the particle arrays
+    uint32_t ensemble_size = 1;
+    uint32_t member_particle_count = 0;
+    std::optional<parameter_sweep> sweep;
+    std::vector<simulation_parameters> ensemble_parameters;
 
     // opengl
     uint32_t particle_position_vao_handle = 0;
     uint32_t render_program_handle = 0;
     uint32_t compute_program_handle[3] {0, 0, 0};
+    uint32_t update_indirect_program_handle = 0;
+    uint32_t mark_sinks_program_handle = 0;
+    uint32_t scan_local_program_handle = 0;
+    uint32_t scan_blocks_program_handle = 0;
+    uint32_t scan_add_program_handle = 0;
+    uint32_t compact_scatter_program_handle = 0;
+    uint32_t compact_gather_program_handle = 0;
+    uint32_t emit_program_handle = 0;
+    // expands the fluid blocks, kept for reset
+    uint32_t spawn_program_handle = 0;
+    uint32_t predict_position_program_handle = 0;
+    uint32_t predict_density_program_handle = 0;
+    uint32_t predict_force_program_handle = 0;
+    uint32_t pcisph_check_program_handle = 0;
+    uint32_t grid_count_program_handle = 0;
+    uint32_t grid_sort_program_handle = 0;
+    uint32_t pbf_predict_program_handle = 0;
+    uint32_t pbf_lambda_program_handle = 0;
+    uint32_t pbf_delta_program_handle = 0;
+    uint32_t pbf_apply_program_handle = 0;
+    uint32_t pbf_velocity_program_handle = 0;
+    uint32_t pbf_finalize_program_handle = 0;
+    uint32_t sleep_mark_program_handle = 0;
+    uint32_t sleep_cells_program_handle = 0;
+    uint32_t sleep_gather_program_handle = 0;
+    uint32_t overlay_program_handle = 0;
+    uint32_t surface_depth_program_handle = 0;
+    uint32_t surface_thickness_program_handle = 0;
+    // horizontal and vertical
+    uint32_t surface_filter_program_handle[2] {0, 0};
+    uint32_t surface_composite_program_handle = 0;
+    uint32_t contour_splat_program_handle = 0;
+    uint32_t contour_extract_program_handle = 0;
+    uint32_t contour_program_handle = 0;
+    uint32_t cull_program_handle = 0;
+    uint32_t density_splat_program_handle = 0;
+    uint32_t density_composite_program_handle = 0;
     uint32_t packed_particles_buffer_handle = 0;
+    bool map_particles = false;
+    void* particle_mapping = nullptr;
+    uint32_t packed_particles_scratch_buffer_handle = 0;
+    uint32_t simulation_state_buffer_handle = 0;
+    uint32_t attribute_layout_buffer_handle = 0;
+    uint32_t compaction_buffer_handle = 0;
+    uint32_t emitter_buffer_handle = 0;
+    uint32_t sink_buffer_handle = 0;
+    uint32_t solver_buffer_handle = 0;
+    uint32_t grid_buffer_handle = 0;
+    uint32_t sleep_buffer_handle = 0;
+    uint32_t parameter_buffer_handle = 0;
+    uint32_t member_parameter_buffer_handle = 0;
+    uint32_t overlay_buffer_handle = 0;
+    uint32_t render_frame_buffer_handle = 0;
+    buffer_range compaction_scan_range {};
+    buffer_range compaction_block_sum_range {};
+    buffer_range grid_scan_range {};
+    buffer_range grid_block_sum_range {};
+    uint32_t num_grid_work_groups = 0;
+    uint32_t num_emit_work_groups = 0;
+    uint32_t signed_distance_field_texture_handle = 0;
+    // depth and thickness of the surface, the filter passes go from the first to the second and back
+    uint32_t surface_texture_handle[2] {0, 0};
+    uint32_t surface_depth_texture_handle = 0;
+    uint32_t surface_framebuffer_handle = 0;
+    // contour state followed by the segment vertices at contour_vertex_offset, and the fixed point density grid
+    uint32_t contour_buffer_handle = 0;
+    uint32_t contour_grid_buffer_handle = 0;
+    GLintptr contour_vertex_offset = 0;
+    // particle count and fixed point speed sum per pixel, and the draw command of the drawn frame
+    uint32_t density_texture_handle[2] {0, 0};
+    uint32_t density_buffer_handle = 0;
+    uint32_t view_buffer_handle = 0;
+    // cull state followed by the visible particle indices at cull_index_offset
+    uint32_t cull_buffer_handle = 0;
+    GLintptr cull_index_offset = 0;
 };
 
 } // namespace sph
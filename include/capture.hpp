@@ -0,0 +1,110 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <GL/gl3w.h>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// pixel buffers a frame can be read into, read_frame waits only when all of them are still being encoded
+#define SPH_CAPTURE_RING 8
+#define SPH_CAPTURE_MAX_ENCODERS 4
+
+namespace sph
+{
+
+// offscreen capture. the frame is drawn into a framebuffer object, read into a ring of persistently mapped pixel buffers
+// and fenced. poll passes the reads that have finished to a pool of encoder threads, which flip the rows, drop the
+// alpha channel and write either one ppm file per frame or one raw rgb24 stream
+class frame_capture
+{
+public:
+    frame_capture() = default;
+    frame_capture(const frame_capture&) = delete;
+    ~frame_capture();
+    // a path with %d or %0Nd writes an image sequence, a .rgb or .raw path a stream of frames.
+    // needs a current OpenGL context, throws std::runtime_error on a bad path or an incomplete framebuffer
+    void start(const std::string& path, uint32_t width, uint32_t height);
+    // waits for the frames in flight and the encoders, then deletes the OpenGL objects
+    void finish();
+    bool active() const;
+    GLuint framebuffer() const;
+    // starts an asynchronous read of the framebuffer
+    void read_frame();
+    // copies the captured image to another framebuffer, the window for instance
+    void blit(GLuint target_framebuffer) const;
+    // hands the reads the gpu has finished to the encoders without waiting, call once per frame
+    void poll();
+    uint64_t frame_count() const;
+
+private:
+    struct slot
+    {
+        GLuint pixel_buffer = 0;
+        const uint8_t* pixels = nullptr;
+        GLsync fence = nullptr;
+        uint64_t frame = 0;
+        // read or encode in flight, guarded by queue_mutex
+        bool busy = false;
+    };
+
+    void run_encoder();
+    void encode(slot& s, std::vector<uint8_t>& rgb);
+    std::string frame_path(uint64_t frame) const;
+
+    bool is_active = false;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    GLuint framebuffer_handle = 0;
+    GLuint color_renderbuffer_handle = 0;
+    std::array<slot, SPH_CAPTURE_RING> slots;
+    uint64_t next_frame = 0;
+    // slots read but not yet handed to the encoders, in frame order
+    std::deque<uint32_t> reading;
+
+    // image sequence, the path around the frame number
+    std::string path_prefix;
+    std::string path_suffix;
+    int frame_digits = 0;
+    // raw stream, written in frame order
+    std::ofstream stream;
+    std::mutex stream_mutex;
+    std::condition_variable stream_turn;
+    uint64_t next_stream_frame = 0;
+
+    std::vector<std::thread> encoders;
+    std::mutex queue_mutex;
+    std::condition_variable queue_changed;
+    std::condition_variable slot_freed;
+    std::deque<uint32_t> encode_queue;
+    bool stopping = false;
+};
+
+} // namespace sph
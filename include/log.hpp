@@ -0,0 +1,89 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// messages waiting for the writer thread, a message is dropped when every slot is taken
+#define SPH_LOG_CAPACITY 1024
+// longer messages are cut off
+#define SPH_LOG_MESSAGE_SIZE 512
+
+namespace sph
+{
+
+enum class log_level : uint32_t
+{
+    debug,
+    info,
+    warning,
+    error,
+};
+
+// printf style, formatted on the calling thread into a queue slot. returns without waiting for the output and never
+// allocates or locks, so it is safe from any thread including OpenGL debug callbacks
+void log_message(log_level level, const char* format, ...);
+// one message per line, for multi-line text such as shader info logs
+void log_lines(log_level level, const char* text);
+
+// bounded multi-producer queue drained by a writer thread, which prints "[LEVEL] message" lines to standard output
+// and flushes once per batch instead of once per line
+class logger
+{
+public:
+    // the process wide instance, its writer thread starts on first use and drains the queue at exit
+    static logger& instance();
+    logger(const logger&) = delete;
+    ~logger();
+    // messages below the level are dropped before they are formatted, info by default
+    void set_level(log_level level);
+    bool enabled(log_level level) const;
+    void push(log_level level, const char* text);
+    uint64_t dropped_count() const;
+
+private:
+    struct slot
+    {
+        // equals the enqueue position when free, position + 1 once the message is written
+        std::atomic<uint64_t> sequence { 0 };
+        log_level level = log_level::info;
+        char text[SPH_LOG_MESSAGE_SIZE] {};
+    };
+
+    logger();
+    void run();
+    bool write_next();
+
+    std::unique_ptr<slot[]> slots;
+    std::atomic<uint64_t> enqueue_position { 0 };
+    // only touched by the writer thread
+    uint64_t dequeue_position = 0;
+    uint64_t reported_drops = 0;
+    std::atomic<uint64_t> drops { 0 };
+    std::atomic<log_level> minimum_level { log_level::info };
+    std::atomic_bool stopping = false;
+    std::thread writer_thread;
+};
+
+} // namespace sph
@@ -0,0 +1,91 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "stats.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace sph
+{
+
+// values published by the simulation thread, copied by the exporter thread
+struct metrics_snapshot
+{
+    uint64_t steps = 0;
+    double simulated_seconds = 0;
+    // seconds since the exporter started, the step rate is derived from it
+    double wall_seconds = 0;
+    // read back from the simulation state buffer a few frames late
+    uint32_t particle_count = 0;
+    uint32_t particle_capacity = 0;
+    // awake grid cells, only known with sleeping cells
+    std::optional<uint32_t> active_cell_count;
+    uint64_t particle_buffer_bytes = 0;
+    float frame_milliseconds = 0;
+    uint64_t gl_performance_messages = 0;
+    // median gpu time of every frame stage
+    std::array<float, static_cast<uint32_t>(frame_stage::count)> gpu_milliseconds {};
+};
+
+// serves the latest snapshot in the Prometheus text format, over http on 127.0.0.1 and/or as a text file for the
+// node exporter textfile collector. the file is written next to the target and renamed over it, so readers never
+// see a partial file. all io happens on the exporter thread, publish never waits for it.
+class metrics_exporter
+{
+public:
+    metrics_exporter() = default;
+    metrics_exporter(const metrics_exporter&) = delete;
+    ~metrics_exporter();
+    // port 0 disables http, an empty path disables the file. throws std::runtime_error if the port cannot be bound
+    void start(const std::string& file_path, uint16_t port, float interval_seconds);
+    void stop();
+    bool running() const;
+    // skips the update if the exporter thread holds the snapshot right now
+    void publish(const metrics_snapshot& snapshot);
+
+private:
+    void run();
+    std::string format(const metrics_snapshot& snapshot);
+    void write_file(const std::string& text) const;
+    void serve(const metrics_snapshot& snapshot);
+
+    std::string file_path;
+    float interval_seconds = 1;
+    std::thread exporter_thread;
+    std::atomic_bool stopping = false;
+    std::mutex snapshot_mutex;
+    metrics_snapshot latest;
+    // for the step rate
+    uint64_t previous_steps = 0;
+    double previous_wall_seconds = 0;
+    double steps_per_second = 0;
+    // listening socket, a SOCKET on windows and a file descriptor elsewhere, ~0 if http is off
+    uintptr_t listen_socket = ~uintptr_t(0);
+};
+
+} // namespace sph
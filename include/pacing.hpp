@@ -0,0 +1,71 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// presentation rate while the window is not focused
+#define SPH_BACKGROUND_PRESENT_RATE 10.f
+// weight of the newest sample in the running step and render costs
+#define SPH_PACING_SMOOTHING 0.1
+
+namespace sph
+{
+
+// schedules presentation at a target rate and hands the rest of every frame interval to the simulation. the step
+// and render costs are gpu times read back from timer queries a few frames late, so the cpu never waits for the gpu
+// to measure them. the steps of an interval are budgeted so that they and the render fill it on the gpu
+class frame_pacer
+{
+public:
+    // a rate of 0 disables pacing
+    void initialize(float present_rate);
+    bool enabled() const;
+    // starts a frame interval, at the background rate while the window is not focused. an interval that was missed is
+    // dropped instead of caught up
+    void begin_frame(bool focused);
+    // whether the gpu time of another step still fits the interval next to the steps taken and the render
+    bool step_fits() const;
+    void add_step();
+    // gpu time of the steps of an earlier frame and of a render
+    void add_step_time(float milliseconds, uint32_t steps);
+    void add_render_time(float milliseconds);
+    // sleeps until the end of the frame interval
+    void wait_for_present() const;
+    uint32_t steps() const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    clock::duration interval {};
+    clock::duration background_interval {};
+    clock::time_point present_deadline;
+    // length of the current interval in seconds, longer while the window is not focused
+    double frame_budget = 0;
+    // running averages in seconds
+    double step_cost = 0;
+    double render_cost = 0;
+    // steps in the current frame interval
+    uint32_t frame_steps = 0;
+};
+
+} // namespace sph
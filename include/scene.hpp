@@ -0,0 +1,124 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sph
+{
+
+enum class solver_type
+{
+    // weakly compressible, pressure from the equation of state
+    sph,
+    // predictive-corrective incompressible, pressure solved iteratively
+    pcisph,
+    // position based fluids, density constraint solved on the positions
+    pbf,
+};
+
+// box of particles on a lattice with a spacing of two particle radii, expanded on the gpu by spawn_blocks.comp.
+// mirrors fluid_block in spawn_blocks.comp
+struct fluid_block
+{
+    glm::vec4 min_corner;
+    // particles along x, y and z, index of the first particle of the block in w
+    glm::uvec4 count;
+};
+
+// spawns a row of particles every interval steps, mirrors emitter in emit.comp
+struct emitter
+{
+    // center of the row
+    glm::vec4 position;
+    // initial velocity, the row is laid out perpendicular to it
+    glm::vec4 velocity;
+    uint32_t particles_per_row;
+    uint32_t interval;
+    uint32_t padding[2];
+};
+
+// axis aligned region that removes every particle inside it, mirrors sink in mark_sinks.comp
+struct sink
+{
+    glm::vec4 min_corner;
+    glm::vec4 max_corner;
+};
+
+// solid geometry baked into the signed distance field at scene load
+struct obstacle
+{
+    enum class shape
+    {
+        circle,
+        box,
+    };
+    shape type;
+    glm::vec2 center;
+    // radius in x for circles, half extents for boxes
+    glm::vec2 size;
+};
+
+// everything a simulation run starts from, see parse_scene for the file format
+struct scene_description
+{
+    // 2 or 3, the 3d scenes run the *.3d.spv shader variants
+    uint32_t dimensions = 2;
+    // the command line may override the solver, the solver picks the time step if the scene does not
+    std::optional<solver_type> solver;
+    std::optional<float> time_step;
+    glm::vec4 gravity = glm::vec4(0, -9806.65f, 0, 0);
+    float stiffness = 2000;
+    float viscosity = 3000;
+    float rest_density = 1000;
+    // the default depends on the dimensions
+    std::optional<float> particle_mass;
+    // walls of the fluid domain, must lie within the [-1, 1] box covered by the neighbor grid
+    glm::vec4 domain_min = glm::vec4(-1, -1, -1, 0);
+    glm::vec4 domain_max = glm::vec4(1, 1, 1, 0);
+    // at least the particle count of the blocks, headroom for emitters
+    uint32_t particle_capacity = 0;
+    uint32_t particle_count = 0;
+    std::vector<fluid_block> blocks;
+    std::vector<emitter> emitters;
+    std::vector<sink> sinks;
+    std::vector<obstacle> obstacles;
+};
+
+// range checks shared by scene files and application::set_parameters, throws std::runtime_error naming the first
+// invalid value. the neighbor grid and the signed distance field only cover the [-1, 1] box, unset values are skipped
+void validate_parameters(std::optional<float> time_step, std::optional<float> particle_mass, float rest_density,
+    const glm::vec4& domain_min, const glm::vec4& domain_max, uint32_t dimensions);
+// parses a scene file, throws std::runtime_error naming the line of the first error
+scene_description parse_scene(std::string_view text, const std::string& source_name);
+scene_description load_scene(const std::string& path);
+// the built-in scenes selected by the -a and -c command line flags
+scene_description default_scene(int64_t scene_id, bool three_dimensional);
+
+} // namespace sph
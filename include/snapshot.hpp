@@ -0,0 +1,149 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <GL/gl3w.h>
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// snapshots copied but not yet written, request drops or delays a snapshot when all of them are in use
+#define SPH_SNAPSHOT_SLOTS 4
+// particles per writer task, the tasks of a snapshot are formatted in parallel
+#define SPH_SNAPSHOT_CHUNK 65536
+#define SPH_SNAPSHOT_MAX_WRITERS 4
+
+namespace sph
+{
+
+// where the particle arrays live on the gpu
+struct snapshot_source
+{
+    GLuint state_buffer;
+    // byte offset of the particle count in the state buffer
+    GLintptr count_offset;
+    GLuint particle_buffer;
+    // byte offsets of the arrays in the particle buffer
+    GLintptr position_offset;
+    GLintptr velocity_offset;
+    GLintptr density_offset;
+    GLintptr pressure_offset;
+    uint32_t particle_capacity;
+    // 2 or 3, vectors are stored as vec2 or padded vec4
+    uint32_t dimensions;
+};
+
+// particle snapshots on disk. request copies the count and the particle arrays into a persistently mapped slot and
+// fences it, poll passes the copies that have finished to a pool of writer threads. a writer lays out the file and
+// splits the particles into chunks the other writers pick up, the last chunk writes the file and frees the slot
+class snapshot_exporter
+{
+public:
+    snapshot_exporter() = default;
+    snapshot_exporter(const snapshot_exporter&) = delete;
+    ~snapshot_exporter();
+    // the extension picks the format: .vtk legacy binary polydata, .csv text, .bin raw float32 arrays with a .json
+    // sidecar. the step number goes between the path and the extension. with delay_when_busy a request waits for a
+    // free slot on a later step instead of dropping the snapshot.
+    // needs a current OpenGL context, throws std::runtime_error on an unknown extension
+    void start(const std::string& path, const snapshot_source& source, bool delay_when_busy);
+    // waits for the snapshots in flight and the writers, then deletes the OpenGL objects
+    void finish();
+    bool active() const;
+    // starts an asynchronous copy of the particles, never waits. false if the snapshot is delayed and should be
+    // requested again
+    bool request(uint64_t step, double time);
+    // hands the copies the gpu has finished to the writers without waiting, call once per step
+    void poll();
+
+private:
+    enum class file_format
+    {
+        vtk,
+        csv,
+        binary
+    };
+
+    struct slot
+    {
+        GLuint buffer = 0;
+        const uint8_t* data = nullptr;
+        GLsync fence = nullptr;
+        uint64_t step = 0;
+        double time = 0;
+        uint32_t particle_count = 0;
+        // the file being formatted. vtk and binary chunks write to fixed offsets of contents, csv chunks to their text
+        std::vector<char> contents;
+        std::vector<std::string> chunk_text;
+        // byte offsets of the sections in contents
+        std::array<size_t, 5> section_offset {};
+        // guarded by queue_mutex
+        uint32_t chunks_left = 0;
+        // copy or write in flight, guarded by queue_mutex
+        bool busy = false;
+    };
+
+    struct task
+    {
+        uint32_t slot_index;
+        // UINT32_MAX lays out the file and queues the chunks
+        uint32_t chunk;
+    };
+
+    void run_writer();
+    void lay_out(slot& s);
+    void format_chunk(slot& s, uint32_t chunk) const;
+    void write_file(slot& s) const;
+    std::string snapshot_path(uint64_t step) const;
+    const float* array(const slot& s, GLintptr offset) const;
+
+    bool is_active = false;
+    bool delay = false;
+    file_format format = file_format::vtk;
+    std::string path_prefix;
+    std::string path_suffix;
+    snapshot_source source {};
+    // byte offsets of the arrays in a slot, the count comes first
+    GLintptr slot_position_offset = 0;
+    GLintptr slot_velocity_offset = 0;
+    GLintptr slot_density_offset = 0;
+    GLintptr slot_pressure_offset = 0;
+    std::array<slot, SPH_SNAPSHOT_SLOTS> slots;
+    // slots copied but not yet handed to the writers, in request order
+    std::deque<uint32_t> copying;
+    uint64_t dropped = 0;
+    uint64_t delayed = 0;
+
+    std::vector<std::thread> writers;
+    std::mutex queue_mutex;
+    std::condition_variable queue_changed;
+    std::deque<task> tasks;
+    uint64_t written = 0;
+    bool stopping = false;
+};
+
+} // namespace sph
@@ -0,0 +1,70 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// c interface of libsph for embedding the solver. a context owns a windowless simulation, its OpenGL context is
+// current on the thread that loaded the scene and every later call has to come from that thread. the functions that
+// return int give 0 on success and -1 on failure, sph_last_error tells why.
+//
+//     sph_context* context = sph_create("bin/");
+//     sph_load_builtin_scene(context, 0, 0);
+//     sph_step(context, 1000);
+//     sph_export(context, "out/particles.vtk");
+//     sph_destroy(context);
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct sph_context sph_context;
+
+typedef struct sph_stats
+{
+    uint64_t steps;
+    double simulated_seconds;
+    // time the last sph_step call took, waiting for the gpu included
+    double step_seconds;
+    uint32_t particle_count;
+    uint32_t particle_capacity;
+    uint32_t dimensions;
+} sph_stats;
+
+// shader_directory holds the compiled shaders, the working directory if NULL. returns NULL if out of memory
+sph_context* sph_create(const char* shader_directory);
+// a scene file, see the readme. replaces the simulation of an earlier load
+int sph_load_scene(sph_context* context, const char* path);
+// the scenes of the executable, 0 the default, 1 the alternate (-a) and 2 the channel (-c)
+int sph_load_builtin_scene(sph_context* context, int scene_id, int three_dimensional);
+// runs count steps and waits for them
+int sph_step(sph_context* context, uint32_t count);
+int sph_get_stats(sph_context* context, sph_stats* stats);
+// writes the particles as vtk, csv or raw binary by the extension of path, with the step number added to the name
+int sph_export(sph_context* context, const char* path);
+// message of the last failed call, empty if none. owned by the context
+const char* sph_last_error(const sph_context* context);
+void sph_destroy(sph_context* context);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,172 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <GL/gl3w.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+// frames kept by every rolling histogram
+#define SPH_STATS_WINDOW 256
+// log-spaced histogram bins, 8 per octave starting at 1/64 ms, so the last bin starts at about one second
+#define SPH_STATS_BINS 128
+#define SPH_STATS_BINS_PER_OCTAVE 8
+#define SPH_STATS_MIN_MS (1.f / 64)
+// gpu timer queries are read back this many frames after they were issued, so reading never stalls the pipeline
+#define SPH_STATS_QUERY_LATENCY 4
+// size of the on-screen overlay in characters
+#define SPH_STATS_OVERLAY_COLUMNS 64
+#define SPH_STATS_OVERLAY_LINES 4
+
+namespace sph
+{
+
+// where frame_stats publishes its summaries
+enum class stats_output
+{
+    none,
+    // window title
+    title,
+    // text drawn over the particles
+    overlay,
+    // standard output
+    console,
+};
+
+// parts of a frame timed on the cpu and on the gpu. the passes are nested in simulation
+enum class frame_stage : uint32_t
+{
+    simulation,
+    render,
+    // neighbor grid build
+    grid,
+    density,
+    force,
+    // pcisph pressure iterations, pbf constraint iterations
+    pressure,
+    integrate,
+    // compaction, emitters and the indirect command update
+    particle_count,
+    count,
+};
+
+const char* stage_name(frame_stage stage);
+
+// durations of the last SPH_STATS_WINDOW samples. adding a sample evicts the oldest one from its bin, so the
+// histogram always covers the same number of frames and never allocates
+class rolling_histogram
+{
+public:
+    void add(float milliseconds);
+    uint32_t count() const;
+    float mean() const;
+    float max() const;
+    // center of the bin holding the given fraction of the samples, accurate to the bin width of about 9%
+    float percentile(float fraction) const;
+
+private:
+    static uint32_t bin_of(float milliseconds);
+
+    std::array<float, SPH_STATS_WINDOW> samples {};
+    std::array<uint16_t, SPH_STATS_BINS> bins {};
+    uint32_t next_sample = 0;
+    uint32_t sample_count = 0;
+    double sum = 0;
+};
+
+// per frame cpu and gpu timings, summarized into fixed text buffers a few times per second instead of every frame
+class frame_stats
+{
+public:
+    // creates the timer queries, needs a current OpenGL context
+    void initialize(float publish_interval_seconds);
+    void destroy();
+    void begin_frame();
+    // stages may nest, each is timed with a pair of gpu timestamps. a stage entered twice in a frame keeps the last
+    void begin_stage(frame_stage stage);
+    void end_stage(frame_stage stage);
+    // true when a new summary is ready, at most once per publish interval
+    bool end_frame();
+    // counts a simulation step of the current frame, kept with its timer queries
+    void add_step();
+    // gpu time of a stage in the frame read back by the last begin_frame, SPH_STATS_QUERY_LATENCY frames old, and the
+    // steps taken in it. false when that frame did not time the stage or its result was still in flight
+    bool read_back(frame_stage stage, float& milliseconds, uint32_t& steps) const;
+    // one line for the title or the console
+    const char* summary() const;
+    // SPH_STATS_OVERLAY_LINES lines of SPH_STATS_OVERLAY_COLUMNS characters, padded with spaces
+    const char* overlay_text() const;
+    const rolling_histogram& frame_histogram() const;
+    const rolling_histogram& cpu_histogram(frame_stage stage) const;
+    const rolling_histogram& gpu_histogram(frame_stage stage) const;
+
+private:
+    void read_queries(uint32_t slot);
+    void format();
+
+    static constexpr uint32_t stage_count = static_cast<uint32_t>(frame_stage::count);
+    using clock = std::chrono::steady_clock;
+
+    rolling_histogram frame_cpu;
+    std::array<rolling_histogram, stage_count> stage_cpu;
+    std::array<rolling_histogram, stage_count> stage_gpu;
+
+    // begin and end timestamp of every stage
+    GLuint queries[SPH_STATS_QUERY_LATENCY][stage_count][2] {};
+    bool query_issued[SPH_STATS_QUERY_LATENCY][stage_count] {};
+    uint32_t query_steps[SPH_STATS_QUERY_LATENCY] {};
+    uint64_t frame_index = 0;
+    // results of the slot read by the last begin_frame, negative for a stage without one
+    std::array<float, stage_count> read_back_gpu {};
+    uint32_t read_back_steps = 0;
+
+    clock::time_point frame_start;
+    std::array<clock::time_point, stage_count> stage_start;
+    clock::time_point last_publish;
+    clock::duration publish_interval {};
+
+    std::array<char, 256> summary_text {};
+    std::array<char, SPH_STATS_OVERLAY_LINES * SPH_STATS_OVERLAY_COLUMNS + 1> overlay_chars {};
+};
+
+// times a stage from construction to destruction
+class stage_scope
+{
+public:
+    stage_scope(frame_stats& stats, frame_stage stage)
+        : stats(stats), stage(stage)
+    {
+        stats.begin_stage(stage);
+    }
+    stage_scope(const stage_scope&) = delete;
+    ~stage_scope()
+    {
+        stats.end_stage(stage);
+    }
+
+private:
+    frame_stats& stats;
+    frame_stage stage;
+};
+
+} // namespace sph
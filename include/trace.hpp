@@ -0,0 +1,148 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <GL/gl3w.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// events kept by the ring buffer, older ones are overwritten
+#define SPH_TRACE_CAPACITY 65536
+// gpu spans waiting for their timestamp queries, a span is dropped when all of them are in flight
+#define SPH_TRACE_GPU_SPANS 4096
+
+#define SPH_TRACE_CONCAT_INNER(a, b) a##b
+#define SPH_TRACE_CONCAT(a, b) SPH_TRACE_CONCAT_INNER(a, b)
+// cpu and gpu span over the rest of the enclosing block, only on the thread owning the OpenGL context
+#define SPH_TRACE_SCOPE(recorder, name) sph::trace_scope SPH_TRACE_CONCAT(trace_scope_, __LINE__)(recorder, name, true)
+// cpu span over the rest of the enclosing block, on any thread
+#define SPH_TRACE_CPU_SCOPE(recorder, name) sph::trace_scope SPH_TRACE_CONCAT(trace_scope_, __LINE__)(recorder, name, false)
+
+namespace sph
+{
+
+// one complete span, times in nanoseconds since the recorder was initialized
+struct trace_event
+{
+    // string literal, only the pointer is stored
+    const char* name;
+    int64_t begin_ns;
+    int64_t end_ns;
+    // 0 is the gpu, cpu threads are numbered from 1 in the order they first record
+    uint32_t track;
+};
+
+// timeline of cpu and gpu spans written as chrome trace json (chrome://tracing, ui.perfetto.dev).
+// cpu spans from any thread go straight into a lock-free ring buffer. gpu spans are a pair of timestamp queries
+// that resolve_gpu_spans moves into the ring once the gpu has passed them, without waiting.
+// when tracing is off a scope costs one branch.
+class trace_recorder
+{
+public:
+    // creates the timestamp queries when enabled, needs a current OpenGL context
+    void initialize(bool enable);
+    void destroy();
+    bool enabled() const
+    {
+        return is_enabled;
+    }
+    int64_t now_ns() const;
+    void record(const char* name, int64_t begin_ns, int64_t end_ns, uint32_t track);
+    // returns the span to pass to end_gpu_span, or SPH_TRACE_GPU_SPANS if every span is in flight
+    uint32_t begin_gpu_span(const char* name);
+    void end_gpu_span(uint32_t span);
+    // moves the finished gpu spans into the ring, call once per frame
+    void resolve_gpu_spans();
+    // snapshot of the ring, throws std::runtime_error if the file cannot be written
+    void write(const std::string& path) const;
+    static uint32_t current_track();
+
+private:
+    struct slot
+    {
+        // odd while the event is being written, 2 * (index + 1) once the fields hold ring entry index
+        std::atomic<uint64_t> sequence { 0 };
+        // the fields of a trace_event. a reader may copy them while a writer overwrites them and then discards the
+        // copy, relaxed atomics keep that race defined
+        std::atomic<const char*> name { nullptr };
+        std::atomic<int64_t> begin_ns { 0 };
+        std::atomic<int64_t> end_ns { 0 };
+        std::atomic<uint32_t> track { 0 };
+    };
+    struct gpu_span
+    {
+        const char* name = nullptr;
+        GLuint begin_query = 0;
+        GLuint end_query = 0;
+    };
+
+    bool is_enabled = false;
+    std::chrono::steady_clock::time_point origin;
+    std::unique_ptr<slot[]> slots;
+    std::atomic<uint64_t> next_slot { 0 };
+
+    std::vector<gpu_span> gpu_spans;
+    // spans from oldest_gpu_span up to next_gpu_span are in flight, in issue order
+    uint64_t next_gpu_span = 0;
+    uint64_t oldest_gpu_span = 0;
+    // cpu time minus gpu time, measured once at initialization
+    int64_t gpu_clock_offset_ns = 0;
+};
+
+// records a span from construction to destruction
+class trace_scope
+{
+public:
+    trace_scope(trace_recorder& recorder, const char* name, bool gpu)
+    {
+        if (!recorder.enabled())
+        {
+            return;
+        }
+        this->recorder = &recorder;
+        this->name = name;
+        gpu_span = gpu ? recorder.begin_gpu_span(name) : SPH_TRACE_GPU_SPANS;
+        begin_ns = recorder.now_ns();
+    }
+    trace_scope(const trace_scope&) = delete;
+    ~trace_scope()
+    {
+        if (recorder == nullptr)
+        {
+            return;
+        }
+        recorder->end_gpu_span(gpu_span);
+        recorder->record(name, begin_ns, recorder->now_ns(), trace_recorder::current_track());
+    }
+
+private:
+    trace_recorder* recorder = nullptr;
+    const char* name = nullptr;
+    uint32_t gpu_span = SPH_TRACE_GPU_SPANS;
+    int64_t begin_ns = 0;
+};
+
+} // namespace sph
@@ -0,0 +1,31 @@
+# builds the sph python module next to the compiled shaders in ../bin:
+#     python setup.py build_ext --build-lib ../bin
+# numpy has to be installed to import it, not to build it
+import glob
+import os
+import sys
+
+from setuptools import Extension, setup
+
+root = os.path.abspath(os.path.join(os.path.dirname(__file__), ".."))
+sources = [os.path.join(root, "python", "sph_module.cpp"), os.path.join(root, "source", "gl3w.c")]
+sources += [path for path in glob.glob(os.path.join(root, "source", "*.cpp")) if os.path.basename(path) != "main.cpp"]
+include_dirs = [os.path.join(root, "include")]
+
+if sys.platform == "win32":
+    glfw = os.path.join(root, "third_party", "glfw-3.3.8.bin.WIN64")
+    include_dirs += [os.path.join(glfw, "include"), os.path.join(os.environ.get("VULKAN_SDK", ""), "Include")]
+    library_dirs = [os.path.join(glfw, "lib-vc2022")]
+    libraries = ["glfw3", "opengl32", "user32", "gdi32", "shell32"]
+    compile_args = ["/std:c++20", "/EHsc"]
+else:
+    library_dirs = []
+    libraries = ["glfw", "GL", "dl", "pthread"]
+    compile_args = ["-std=c++20"]
+
+setup(
+    name="sph",
+    version="1.0",
+    ext_modules=[Extension("sph", sources, include_dirs=include_dirs, library_dirs=library_dirs, libraries=libraries,
+        extra_compile_args=compile_args, language="c++")],
+)
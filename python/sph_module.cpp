@@ -0,0 +1,543 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// python module over a headless, lockstep sph::application. the particle arrays are numpy views of the persistently
+// mapped particle buffer, reading them copies nothing and writing them changes the particles of the next step.
+//
+//     import sph
+//     simulation = sph.Simulation(solver="pcisph")
+//     simulation.step(100)
+//     print(simulation.position.mean(axis=0), simulation.density.max())
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "application.hpp"
+
+#include <cmath>
+#include <exception>
+#include <string>
+
+namespace
+{
+
+// numpy.asarray, looked up when the module is imported
+PyObject* as_array = nullptr;
+// without EGL every application initializes and terminates glfw, so only one may exist at a time
+bool simulation_exists = false;
+
+struct simulation_object
+{
+    PyObject_HEAD
+    sph::application* app;
+    // the gl context is current on the thread that created the application only
+    unsigned long owner_thread;
+};
+
+// buffer protocol over one array of the packed particle buffer, keeps the simulation alive
+struct particle_array_object
+{
+    PyObject_HEAD
+    PyObject* owner;
+    char* data;
+    int ndim;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+};
+
+// arrays of the packed buffer in attribute order, the vectors are the first three
+const char* array_names[] = { "position", "velocity", "force", "density", "pressure" };
+constexpr uint32_t vector_arrays = 3;
+
+// turns a c++ exception into a python one, returns nullptr
+PyObject* raise(const std::exception& e)
+{
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return nullptr;
+}
+
+// the context stays on this thread, other python threads may run while it waits for the gpu
+PyObject* step_without_lock(simulation_object* self, uint32_t count)
+{
+    std::string error;
+    Py_BEGIN_ALLOW_THREADS
+    try
+    {
+        self->app->step(count);
+        self->app->synchronize();
+    }
+    catch (const std::exception& e)
+    {
+        error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    if (!error.empty())
+    {
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+// the spv files are installed next to the module
+std::string module_directory()
+{
+    PyObject* module = PyImport_AddModule("sph");
+    PyObject* path = module != nullptr ? PyModule_GetFilenameObject(module) : nullptr;
+    if (path == nullptr)
+    {
+        PyErr_Clear();
+        return "";
+    }
+    const char* file = PyUnicode_AsUTF8(path);
+    std::string directory = file != nullptr ? file : "";
+    directory.erase(directory.find_last_of("/\\") + 1);
+    Py_DECREF(path);
+    PyErr_Clear();
+    return directory;
+}
+
+bool check_initialized(simulation_object* self)
+{
+    if (self->app == nullptr)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "the simulation is not initialized");
+        return false;
+    }
+    if (PyThread_get_thread_ident() != self->owner_thread)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "the simulation can only be used from the thread that created it");
+        return false;
+    }
+    return true;
+}
+
+int particle_array_get_buffer(PyObject* object, Py_buffer* view, int flags)
+{
+    auto* self = reinterpret_cast<particle_array_object*>(object);
+    const bool contiguous = self->ndim == 1 ? self->strides[0] == sizeof(float) : self->strides[0] == self->shape[1] * Py_ssize_t(sizeof(float));
+    if (!contiguous && (flags & PyBUF_STRIDES) != PyBUF_STRIDES)
+    {
+        // 3d vectors carry a padding component
+        PyErr_SetString(PyExc_BufferError, "the particle array is strided");
+        return -1;
+    }
+    view->obj = object;
+    Py_INCREF(object);
+    view->buf = self->data;
+    view->len = self->shape[0] * (self->ndim == 2 ? self->shape[1] : 1) * Py_ssize_t(sizeof(float));
+    view->readonly = 0;
+    view->itemsize = sizeof(float);
+    view->format = (flags & PyBUF_FORMAT) != 0 ? const_cast<char*>("f") : nullptr;
+    view->ndim = self->ndim;
+    view->shape = (flags & PyBUF_ND) == PyBUF_ND ? self->shape : nullptr;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    return 0;
+}
+
+void particle_array_dealloc(PyObject* object)
+{
+    Py_XDECREF(reinterpret_cast<particle_array_object*>(object)->owner);
+    Py_TYPE(object)->tp_free(object);
+}
+
+PyBufferProcs particle_array_buffer = { particle_array_get_buffer, nullptr };
+
+PyTypeObject particle_array_type = { PyVarObject_HEAD_INIT(nullptr, 0) };
+
+int simulation_init(PyObject* object, PyObject* args, PyObject* kwargs)
+{
+    auto* self = reinterpret_cast<simulation_object*>(object);
+    const char* keywords[] = { "scene", "scene_id", "three_dimensional", "solver", "sleeping", "shader_directory", nullptr };
+    const char* scene_path = nullptr;
+    long long scene_id = 0;
+    int three_dimensional = 0;
+    const char* solver = nullptr;
+    int sleeping = 0;
+    const char* shader_directory = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|zLpzpz", const_cast<char**>(keywords), &scene_path, &scene_id, &three_dimensional,
+        &solver, &sleeping, &shader_directory))
+    {
+        return -1;
+    }
+    if (self->app != nullptr || simulation_exists)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "only one simulation can exist at a time");
+        return -1;
+    }
+    sph::application_options options;
+    options.scene_path = scene_path != nullptr ? scene_path : "";
+    options.scene_id = scene_id;
+    options.three_dimensional = three_dimensional != 0;
+    if (solver != nullptr)
+    {
+        const std::string name = solver;
+        if (name == "sph")
+        {
+            options.solver = sph::solver_type::sph;
+        }
+        else if (name == "pcisph")
+        {
+            options.solver = sph::solver_type::pcisph;
+        }
+        else if (name == "pbf")
+        {
+            options.solver = sph::solver_type::pbf;
+        }
+        else
+        {
+            PyErr_SetString(PyExc_ValueError, "solver must be sph, pcisph or pbf");
+            return -1;
+        }
+    }
+    options.sleeping = sleeping != 0;
+    options.shader_directory = shader_directory != nullptr ? shader_directory : module_directory();
+    if (!options.shader_directory.empty() && options.shader_directory.back() != '/' && options.shader_directory.back() != '\\')
+    {
+        options.shader_directory += '/';
+    }
+    options.windowless = true;
+    options.simulation_thread = false;
+    options.mapped_particles = true;
+    options.stats = sph::stats_output::none;
+    try
+    {
+        self->app = new sph::application(options);
+    }
+    catch (const std::exception& e)
+    {
+        raise(e);
+        return -1;
+    }
+    self->owner_thread = PyThread_get_thread_ident();
+    simulation_exists = true;
+    return 0;
+}
+
+void simulation_dealloc(PyObject* object)
+{
+    auto* self = reinterpret_cast<simulation_object*>(object);
+    if (self->app != nullptr)
+    {
+        delete self->app;
+        simulation_exists = false;
+    }
+    Py_TYPE(object)->tp_free(object);
+}
+
+PyObject* simulation_step(PyObject* object, PyObject* args, PyObject* kwargs)
+{
+    auto* self = reinterpret_cast<simulation_object*>(object);
+    const char* keywords[] = { "count", nullptr };
+    unsigned int count = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|I", const_cast<char**>(keywords), &count) || !check_initialized(self))
+    {
+        return nullptr;
+    }
+    return step_without_lock(self, count);
+}
+
+PyObject* simulation_run(PyObject* object, PyObject* args, PyObject* kwargs)
+{
+    auto* self = reinterpret_cast<simulation_object*>(object);
+    const char* keywords[] = { "duration", nullptr };
+    double duration = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "d", const_cast<char**>(keywords), &duration) || !check_initialized(self))
+    {
+        return nullptr;
+    }
+    // whole steps up to the simulated time
+    const double time_step = self->app->parameters().time_step;
+    const double steps = std::ceil(duration / time_step - 1e-6);
+    if (!(steps >= 0 && steps <= UINT32_MAX))
+    {
+        PyErr_SetString(PyExc_ValueError, "duration out of range");
+        return nullptr;
+    }
+    return step_without_lock(self, static_cast<uint32_t>(steps));
+}
+
+PyObject* simulation_reset(PyObject* object, PyObject*)
+{
+    auto* self = reinterpret_cast<simulation_object*>(object);
+    if (!check_initialized(self))
+    {
+        return nullptr;
+    }
+    try
+    {
+        self->app->reset();
+        self->app->synchronize();
+    }
+    catch (const std::exception& e)
+    {
+        return raise(e);
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject* vector_tuple(const glm::vec4& v)
+{
+    return Py_BuildValue("(ddd)", double(v.x), double(v.y), double(v.z));
+}
+
+// a sequence of 2 or 3 numbers, z is 0 if left out
+bool parse_vector(PyObject* value, glm::vec4& v)
+{
+    PyObject* sequence = PySequence_Fast(value, "expected a sequence of 2 or 3 numbers");
+    if (sequence == nullptr)
+    {
+        return false;
+    }
+    const Py_ssize_t size = PySequence_Fast_GET_SIZE(sequence);
+    float components[3] = { 0, 0, 0 };
+    bool valid = size == 2 || size == 3;
+    for (Py_ssize_t i = 0; valid && i < size; i++)
+    {
+        components[i] = static_cast<float>(PyFloat_AsDouble(PySequence_Fast_GET_ITEM(sequence, i)));
+        valid = !PyErr_Occurred();
+    }
+    Py_DECREF(sequence);
+    if (!valid)
+    {
+        if (!PyErr_Occurred())
+        {
+            PyErr_SetString(PyExc_ValueError, "expected a sequence of 2 or 3 numbers");
+        }
+        return false;
+    }
+    v.x = components[0];
+    v.y = components[1];
+    v.z = components[2];
+    return true;
+}
+
+PyObject* simulation_get_parameters(PyObject* object, PyObject*)
+{
+    auto* self = reinterpret_cast<simulation_object*>(object);
+    if (!check_initialized(self))
+    {
+        return nullptr;
+    }
+    const sph::simulation_parameters& p = self->app->parameters();
+    return Py_BuildValue("{s:N,s:N,s:N,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d}",
+        "gravity", vector_tuple(p.gravity), "domain_min", vector_tuple(p.domain_min), "domain_max", vector_tuple(p.domain_max),
+        "time_step", double(p.time_step), "particle_mass", double(p.particle_mass), "rest_density", double(p.rest_density),
+        "stiffness", double(p.stiffness), "viscosity", double(p.viscosity), "pcisph_delta", double(p.pcisph_delta),
+        "lattice_rest_density", double(p.lattice_rest_density), "pbf_relaxation", double(p.pbf_relaxation));
+}
+
+// keyword arguments override the current parameters, the derived ones are recomputed
+PyObject* simulation_set_parameters(PyObject* object, PyObject* args, PyObject* kwargs)
+{
+    auto* self = reinterpret_cast<simulation_object*>(object);
+    if (PyTuple_GET_SIZE(args) != 0)
+    {
+        PyErr_SetString(PyExc_TypeError, "set_parameters takes keyword arguments only");
+        return nullptr;
+    }
+    if (!check_initialized(self))
+    {
+        return nullptr;
+    }
+    sph::simulation_parameters p = self->app->parameters();
+    PyObject* key = nullptr;
+    PyObject* value = nullptr;
+    Py_ssize_t position = 0;
+    while (kwargs != nullptr && PyDict_Next(kwargs, &position, &key, &value))
+    {
+        const char* name = PyUnicode_AsUTF8(key);
+        if (name == nullptr)
+        {
+            return nullptr;
+        }
+        const std::string parameter = name;
+        glm::vec4* vector = parameter == "gravity" ? &p.gravity : parameter == "domain_min" ? &p.domain_min : parameter == "domain_max" ? &p.domain_max : nullptr;
+        float* scalar = parameter == "time_step" ? &p.time_step : parameter == "particle_mass" ? &p.particle_mass :
+            parameter == "rest_density" ? &p.rest_density : parameter == "stiffness" ? &p.stiffness : parameter == "viscosity" ? &p.viscosity : nullptr;
+        if (vector != nullptr)
+        {
+            if (!parse_vector(value, *vector))
+            {
+                return nullptr;
+            }
+        }
+        else if (scalar != nullptr)
+        {
+            *scalar = static_cast<float>(PyFloat_AsDouble(value));
+            if (PyErr_Occurred())
+            {
+                return nullptr;
+            }
+        }
+        else
+        {
+            PyErr_Format(PyExc_TypeError, "unknown or derived parameter %s", name);
+            return nullptr;
+        }
+    }
+    try
+    {
+        self->app->set_parameters(p);
+    }
+    catch (const std::exception& e)
+    {
+        return raise(e);
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject* simulation_get_step_count(PyObject* object, void*)
+{
+    auto* self = reinterpret_cast<simulation_object*>(object);
+    return check_initialized(self) ? PyLong_FromUnsignedLongLong(self->app->step_count()) : nullptr;
+}
+
+PyObject* simulation_get_time(PyObject* object, void*)
+{
+    auto* self = reinterpret_cast<simulation_object*>(object);
+    return check_initialized(self) ? PyFloat_FromDouble(self->app->simulated_time()) : nullptr;
+}
+
+PyObject* simulation_get_particle_count(PyObject* object, void*)
+{
+    auto* self = reinterpret_cast<simulation_object*>(object);
+    return check_initialized(self) ? PyLong_FromUnsignedLong(self->app->particle_count()) : nullptr;
+}
+
+PyObject* simulation_get_dimensions(PyObject* object, void*)
+{
+    auto* self = reinterpret_cast<simulation_object*>(object);
+    return check_initialized(self) ? PyLong_FromUnsignedLong(self->app->dimensions()) : nullptr;
+}
+
+// a numpy view of the live particles of one array. the closure is the array index. the view keeps its row count,
+// emitters and sinks change the count so it is taken again after stepping
+PyObject* simulation_get_array(PyObject* object, void* closure)
+{
+    auto* self = reinterpret_cast<simulation_object*>(object);
+    if (!check_initialized(self))
+    {
+        return nullptr;
+    }
+    const uint32_t index = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(closure));
+    const sph::particle_attribute& attribute = self->app->attributes()[index];
+    auto* array = PyObject_New(particle_array_object, &particle_array_type);
+    if (array == nullptr)
+    {
+        return nullptr;
+    }
+    Py_INCREF(object);
+    array->owner = object;
+    array->data = static_cast<char*>(self->app->mapped_particles()) + size_t(attribute.offset) * sizeof(uint32_t);
+    array->shape[0] = self->app->particle_count();
+    array->strides[0] = attribute.size * sizeof(uint32_t);
+    array->ndim = index < vector_arrays ? 2 : 1;
+    array->shape[1] = self->app->dimensions();
+    array->strides[1] = sizeof(float);
+    PyObject* result = PyObject_CallOneArg(as_array, reinterpret_cast<PyObject*>(array));
+    Py_DECREF(array);
+    return result;
+}
+
+PyMethodDef simulation_methods[] =
+{
+    { "step", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(simulation_step)), METH_VARARGS | METH_KEYWORDS,
+        "step(count=1)\n\nadvances the simulation by count steps and waits for them" },
+    { "run", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(simulation_run)), METH_VARARGS | METH_KEYWORDS,
+        "run(duration)\n\nsteps until duration more seconds are simulated" },
+    { "reset", simulation_reset, METH_NOARGS, "reset()\n\nrespawns the particles of the scene at step 0, the parameters are kept" },
+    { "parameters", simulation_get_parameters, METH_NOARGS, "parameters()\n\nthe simulation parameters as a dict" },
+    { "set_parameters", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(simulation_set_parameters)), METH_VARARGS | METH_KEYWORDS,
+        "set_parameters(**parameters)\n\nchanges parameters from the next step, e.g. set_parameters(viscosity=3000, gravity=(0, -9.8))" },
+    { nullptr, nullptr, 0, nullptr }
+};
+
+PyGetSetDef simulation_getset[] =
+{
+    { "step_count", simulation_get_step_count, nullptr, "steps since the start or the last reset", nullptr },
+    { "time", simulation_get_time, nullptr, "simulated seconds", nullptr },
+    { "particle_count", simulation_get_particle_count, nullptr, "live particles", nullptr },
+    { "dimensions", simulation_get_dimensions, nullptr, "2 or 3", nullptr },
+    { array_names[0], simulation_get_array, nullptr, "(n, dimensions) float32 view of the positions", reinterpret_cast<void*>(0) },
+    { array_names[1], simulation_get_array, nullptr, "(n, dimensions) float32 view of the velocities", reinterpret_cast<void*>(1) },
+    { array_names[2], simulation_get_array, nullptr, "(n, dimensions) float32 view of the forces of the last step", reinterpret_cast<void*>(2) },
+    { array_names[3], simulation_get_array, nullptr, "(n,) float32 view of the densities", reinterpret_cast<void*>(3) },
+    { array_names[4], simulation_get_array, nullptr, "(n,) float32 view of the pressures, the constraint multipliers with pbf", reinterpret_cast<void*>(4) },
+    { nullptr, nullptr, nullptr, nullptr, nullptr }
+};
+
+PyTypeObject simulation_type = { PyVarObject_HEAD_INIT(nullptr, 0) };
+
+PyModuleDef sph_module = { PyModuleDef_HEAD_INIT, "sph", "smoothed particle hydrodynamics on the gpu", -1, nullptr };
+
+} // namespace
+
+PyMODINIT_FUNC PyInit_sph()
+{
+    particle_array_type.tp_name = "sph.ParticleArray";
+    particle_array_type.tp_basicsize = sizeof(particle_array_object);
+    particle_array_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    particle_array_type.tp_dealloc = particle_array_dealloc;
+    particle_array_type.tp_as_buffer = &particle_array_buffer;
+    particle_array_type.tp_doc = "memory of one particle array, wrapped by numpy";
+
+    simulation_type.tp_name = "sph.Simulation";
+    simulation_type.tp_basicsize = sizeof(simulation_object);
+    simulation_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    simulation_type.tp_new = PyType_GenericNew;
+    simulation_type.tp_init = simulation_init;
+    simulation_type.tp_dealloc = simulation_dealloc;
+    simulation_type.tp_methods = simulation_methods;
+    simulation_type.tp_getset = simulation_getset;
+    simulation_type.tp_doc = "Simulation(scene=None, scene_id=0, three_dimensional=False, solver=None, sleeping=False, shader_directory=None)\n\n"
+        "a headless simulation stepped from python. the particle arrays are views of gpu memory mapped into the process";
+
+    if (PyType_Ready(&particle_array_type) < 0 || PyType_Ready(&simulation_type) < 0)
+    {
+        return nullptr;
+    }
+    PyObject* numpy = PyImport_ImportModule("numpy");
+    if (numpy == nullptr)
+    {
+        return nullptr;
+    }
+    as_array = PyObject_GetAttrString(numpy, "asarray");
+    Py_DECREF(numpy);
+    if (as_array == nullptr)
+    {
+        return nullptr;
+    }
+    PyObject* module = PyModule_Create(&sph_module);
+    if (module == nullptr)
+    {
+        return nullptr;
+    }
+    Py_INCREF(&simulation_type);
+    if (PyModule_AddObject(module, "Simulation", reinterpret_cast<PyObject*>(&simulation_type)) < 0)
+    {
+        Py_DECREF(&simulation_type);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
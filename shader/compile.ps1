@@ -5,5 +5,10 @@ If(!(test-path -PathType container $path))
 }
 Get-ChildItem -Recurse -Include ("*.vert", "*.frag", "*.comp", "*.geom", "*.tesc", "*.tese") | Foreach {
   $outfile = [System.IO.Path]::GetFullPath((Join-Path (Join-Path $pwd "../bin") ($_.Name + ".spv")))
-  & $env:VULKAN_SDK\Bin\glslangvalidator.exe -V $_.FullName -o $outfile
+  # -G targets OpenGL semantics, the vertex shaders read gl_VertexID which Vulkan semantics (-V) do not have.
+  # -I resolves the #include of the shared *.glsl files, which are not compiled on their own
+  & $env:VULKAN_SDK\Bin\glslangvalidator.exe -G "-I$pwd" $_.FullName -o $outfile
+  # 3d variant, loaded instead of the 2d one when the application runs in 3d
+  $outfile3d = [System.IO.Path]::GetFullPath((Join-Path (Join-Path $pwd "../bin") ($_.Name + ".3d.spv")))
+  & $env:VULKAN_SDK\Bin\glslangvalidator.exe -G "-I$pwd" -DSPH_3D $_.FullName -o $outfile3d
 }
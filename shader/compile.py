@@ -7,11 +7,17 @@ shader_files = []
 for exts in ('*.vert', '*.frag', '*.comp', '*.geom', '*.tesc', '*.tese'):
     shader_files.extend(glob.glob(os.path.join("./", exts)))
 
+# -G targets OpenGL semantics, the vertex shaders read gl_VertexID which Vulkan semantics (-V) do not have.
+# -I resolves the #include of the shared *.glsl files, which are not compiled on their own
 failed_files = []
 for shader_file in shader_files:
     print("compiling %s\n" % shader_file)
-    if subprocess.call("glslangvalidator -V %s -o ../bin/%s.spv" % (shader_file, shader_file), shell=True) != 0:
+    if subprocess.call("glslangvalidator -G -I. %s -o ../bin/%s.spv" % (shader_file, shader_file), shell=True) != 0:
         failed_files.append(shader_file)
+    # 3d variant, loaded instead of the 2d one when the application runs in 3d
+    print("compiling %s (3d)\n" % shader_file)
+    if subprocess.call("glslangvalidator -G -I. -DSPH_3D %s -o ../bin/%s.3d.spv" % (shader_file, shader_file), shell=True) != 0:
+        failed_files.append(shader_file + " (3d)")
 
 for failed_file in failed_files:
     print("Failed to compile " + failed_file + "\n")
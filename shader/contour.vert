@@ -0,0 +1,53 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#version 460
+
+// boundary contour segments, pulled from the vertex list of contour_extract.comp
+layout(std430, binding = 26) buffer contour_vertex_block
+{
+    vec2 vertices[];
+};
+
+// ensemble mode traces the first simulation, drawn in its tile like particle.vert
+layout(constant_id = 7) const uint ENSEMBLE_SIZE = 1;
+
+// camera, mirrors view_parameters in application.hpp
+layout(std140, binding = 1) uniform view_block
+{
+    vec2 view_center;
+    float view_zoom;
+};
+
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+
+void main()
+{
+    gl_Position = vec4(vertices[gl_VertexID], 0, 1);
+    if (ENSEMBLE_SIZE > 1)
+    {
+        uint columns = uint(ceil(sqrt(float(ENSEMBLE_SIZE))));
+        gl_Position.xy = (gl_Position.xy + 1 + 2 * vec2(0, columns - 1)) / columns - 1;
+    }
+    gl_Position.xy = (gl_Position.xy - view_center) * view_zoom;
+}
@@ -0,0 +1,50 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#version 460
+
+// aggregate renderer, second pass. drawn with the full screen triangle of surface_composite.vert, colors every pixel
+// by the mean speed of its particles and covers the background by their number
+#define SPEED_FIXED_POINT 1024.f
+#define MAX_SPEED 2.f
+// particles per pixel that cover about two thirds of the background
+#define COVERAGE_COUNT 2.f
+#define SLOW_COLOR vec3(0.1f, 0.25f, 0.7f)
+#define FAST_COLOR vec3(0.95f, 0.45f, 0.1f)
+#define BACKGROUND_COLOR vec3(0.92f)
+
+layout(binding = 2, r32ui) uniform readonly uimage2D particle_count_image;
+layout(binding = 3, r32ui) uniform readonly uimage2D speed_image;
+
+layout(location = 0) out vec4 color;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    uint particle_count = imageLoad(particle_count_image, pixel).r;
+    if (particle_count == 0)
+    {
+        discard;
+    }
+    float mean_speed = float(imageLoad(speed_image, pixel).r) / SPEED_FIXED_POINT / float(particle_count);
+    vec3 fluid_color = mix(SLOW_COLOR, FAST_COLOR, mean_speed / MAX_SPEED);
+    float coverage = 1 - exp(-float(particle_count) / COVERAGE_COUNT);
+    color = vec4(mix(BACKGROUND_COLOR, fluid_color, coverage), 1);
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#version 460
+
+// text overlay of the frame statistics, see stats.hpp
+#define GLYPH_SCALE 2
+#define CELL_WIDTH 4
+#define CELL_HEIGHT 6
+#define MARGIN 8
+
+layout(std430, binding = 23) buffer overlay_block
+{
+    uvec2 viewport;
+    uint line_count;
+    uint column_count;
+    // one character per element
+    uint text[];
+};
+
+// 3x5 pixel glyphs of the characters 32 to 95, rows from the top in bits 14 to 0, lower case is drawn as upper case
+const uint FONT[64] = uint[64](
+    0x0000u, 0x0000u, 0x0000u, 0x0000u, 0x0000u, 0x52a5u, 0x0000u, 0x0000u,
+    0x1491u, 0x4494u, 0x0000u, 0x05d0u, 0x0014u, 0x01c0u, 0x0002u, 0x12a4u,
+    0x7b6fu, 0x2c97u, 0x73e7u, 0x73cfu, 0x5bc9u, 0x79cfu, 0x79efu, 0x7249u,
+    0x7befu, 0x7bcfu, 0x0410u, 0x0000u, 0x0000u, 0x0e38u, 0x0000u, 0x0000u,
+    0x0000u, 0x2bedu, 0x6baeu, 0x3923u, 0x6b6eu, 0x79a7u, 0x79a4u, 0x396bu,
+    0x5bedu, 0x7497u, 0x126au, 0x5badu, 0x4927u, 0x5fedu, 0x6b6du, 0x2b6au,
+    0x6ba4u, 0x2b73u, 0x6badu, 0x388eu, 0x7492u, 0x5b6fu, 0x5b6au, 0x5bfdu,
+    0x5aadu, 0x5a92u, 0x72a7u, 0x0000u, 0x0000u, 0x0000u, 0x0000u, 0x0007u
+);
+
+layout(location = 0) out vec4 color;
+
+void main()
+{
+    // font pixel from the top left corner of the text
+    ivec2 p = (ivec2(gl_FragCoord.x, viewport.y - gl_FragCoord.y) - MARGIN) / GLYPH_SCALE;
+    uint column = p.x / CELL_WIDTH;
+    uint line = p.y / CELL_HEIGHT;
+    ivec2 local = p % ivec2(CELL_WIDTH, CELL_HEIGHT);
+    // the last column and row of a cell are the spacing
+    if (local.x >= 3 || local.y >= 5 || column >= column_count || line >= line_count)
+    {
+        discard;
+    }
+    uint c = text[line * column_count + column];
+    if (c >= 97 && c <= 122)
+    {
+        c -= 32;
+    }
+    uint glyph = c >= 32 && c < 96 ? FONT[c - 32] : 0u;
+    if (((glyph >> (14 - local.y * 3 - local.x)) & 1u) == 0)
+    {
+        discard;
+    }
+    color = vec4(0.7f, 0, 0, 1);
+}
@@ -0,0 +1,50 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#version 460
+
+// text overlay of the frame statistics, see stats.hpp
+#define GLYPH_SCALE 2
+#define CELL_WIDTH 4
+#define CELL_HEIGHT 6
+#define MARGIN 8
+
+layout(std430, binding = 23) buffer overlay_block
+{
+    uvec2 viewport;
+    uint line_count;
+    uint column_count;
+    uint text[];
+};
+
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+
+// one quad over the text in the top left corner, drawn as a triangle strip of 4 vertices
+void main()
+{
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 size = vec2(column_count * CELL_WIDTH, line_count * CELL_HEIGHT) * GLYPH_SCALE;
+    // pixels from the top left corner of the window
+    vec2 pixel = MARGIN + corner * size;
+    gl_Position = vec4(pixel.x / viewport.x * 2 - 1, 1 - pixel.y / viewport.y * 2, 0, 1);
+}
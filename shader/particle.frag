@@ -20,9 +20,11 @@
 
 #version 460
 
+layout(location = 0) in vec3 point_color;
+
 layout(location = 0) out vec4 color;
 
 void main ()
 {
-    color = vec4(0, 0, 0, 1);
+    color = vec4(point_color, 1);
 }
@@ -19,8 +19,57 @@
 // SOFTWARE.
 
 #version 460
+#extension GL_GOOGLE_include_directive : require
 
-layout (location = 0) in vec2 position;
+#ifdef SPH_3D
+#define particle_vector vec4
+#else
+#define particle_vector vec2
+#endif
+
+// positions at the binding of the simulation kernels, the vao has no attributes
+layout(std430, binding = 0) buffer position_block
+{
+    particle_vector position[];
+};
+
+// the projection, the ensemble tiles and the camera
+#include "view.glsl"
+
+// point diameter in pixels for the splats of the other renderers at zoom 1, 0 keeps the sizes below
+layout(constant_id = 4) const float POINT_SIZE = 0;
+// draws the particles listed by cull.comp, the vertex id indexes the list instead of the particles
+layout(constant_id = 14) const bool CULLED = false;
+// particle attribute the points are colored by, pulled from the simulation buffers by particle index.
+// 0: none (black), 1: speed, 2: density, 3: pressure
+layout(constant_id = 10) const uint COLOR_ATTRIBUTE = 0;
+// 0: viridis, 1: diverging blue to red, 2: grayscale
+layout(constant_id = 11) const uint COLOR_MAP = 0;
+// attribute values mapped to the ends of the color map
+layout(constant_id = 12) const float COLOR_MIN = 0;
+layout(constant_id = 13) const float COLOR_MAX = 1;
+
+layout(std430, binding = 1) buffer velocity_block
+{
+    particle_vector velocity[];
+};
+
+layout(std430, binding = 3) buffer density_block
+{
+    float density[];
+};
+
+layout(std430, binding = 4) buffer pressure_block
+{
+    float pressure[];
+};
+
+layout(std430, binding = 31) buffer visible_index_block
+{
+    uint visible_index[];
+};
+
+layout(location = 0) out vec3 color;
 
 out gl_PerVertex
 {
@@ -28,8 +77,51 @@ out gl_PerVertex
     float gl_PointSize;
 };
 
+vec3 color_map(float t)
+{
+    if (COLOR_MAP == 1)
+    {
+        return t < 0.5f ? mix(vec3(0.23f, 0.3f, 0.75f), vec3(0.87f), 2 * t) : mix(vec3(0.87f), vec3(0.71f, 0.02f, 0.15f), 2 * t - 1);
+    }
+    if (COLOR_MAP == 2)
+    {
+        return vec3(0.9f * (1 - t));
+    }
+    // piecewise linear through five samples of viridis
+    const vec3 viridis[5] = vec3[](vec3(0.267f, 0.005f, 0.329f), vec3(0.229f, 0.322f, 0.546f), vec3(0.128f, 0.567f, 0.551f),
+        vec3(0.369f, 0.789f, 0.383f), vec3(0.993f, 0.906f, 0.144f));
+    float x = t * 4;
+    int k = min(int(x), 3);
+    return mix(viridis[k], viridis[k + 1], x - k);
+}
+
 void main ()
 {
-    gl_Position = vec4(position.x, position.y, 0, 1);
+    uint i = CULLED ? visible_index[gl_VertexID] : uint(gl_VertexID);
+    gl_Position = vec4(view_project(position[i], i), 1);
+#ifdef SPH_3D
+    gl_PointSize = 2;
+#else
     gl_PointSize = 5;
+#endif
+    color = vec3(0);
+    if (COLOR_ATTRIBUTE != 0)
+    {
+#ifdef SPH_3D
+        float speed = length(velocity[i].xyz);
+#else
+        float speed = length(velocity[i]);
+#endif
+        float value = COLOR_ATTRIBUTE == 1 ? speed : COLOR_ATTRIBUTE == 2 ? density[i] : pressure[i];
+        color = color_map(clamp((value - COLOR_MIN) / (COLOR_MAX - COLOR_MIN), 0.f, 1.f));
+    }
+    if (POINT_SIZE > 0)
+    {
+        // splats cover a sphere, so they grow with the zoom
+        gl_PointSize = POINT_SIZE * view_zoom;
+    }
+    if (ENSEMBLE_SIZE > 1)
+    {
+        gl_PointSize = max(gl_PointSize / ensemble_columns(), 1);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,65 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#version 460
+
+// screen-space surface, last pass. shades the smoothed depth and thickness over the background, see application::render_surface
+// matches the clear color in application.cpp
+#define BACKGROUND_COLOR vec3(0.92f)
+#define FLUID_COLOR vec3(0.1f, 0.45f, 0.8f)
+// absorption per unit of thickness in normalized device coordinates, red goes first as in water
+#define ABSORPTION vec3(18.f, 7.f, 3.f)
+#define LIGHT_DIRECTION vec3(-0.4f, 0.6f, 0.7f)
+#define SHININESS 60.f
+
+// depth in r and thickness in g, linearly filtered. unit 0 holds the signed distance field
+layout(binding = 1) uniform sampler2D surface;
+
+layout(location = 0) in vec2 uv;
+layout(location = 0) out vec4 color;
+
+// of the two one-sided differences the smaller one, so the gradient does not jump at the silhouette
+float depth_slope(float center, float before, float after)
+{
+    float forward = after - center;
+    float backward = center - before;
+    return abs(forward) < abs(backward) ? forward : backward;
+}
+
+void main()
+{
+    vec2 depth_thickness = texture(surface, uv).rg;
+    if (depth_thickness.g <= 0.001f)
+    {
+        discard;
+    }
+    vec2 texel = 1.f / textureSize(surface, 0);
+    float depth = depth_thickness.r;
+    float slope_x = depth_slope(depth, texture(surface, uv - vec2(texel.x, 0)).r, texture(surface, uv + vec2(texel.x, 0)).r);
+    float slope_y = depth_slope(depth, texture(surface, uv - vec2(0, texel.y)).r, texture(surface, uv + vec2(0, texel.y)).r);
+    // window depth per texel to normalized device depth per normalized device unit
+    vec3 normal = normalize(vec3(-slope_x / texel.x, -slope_y / texel.y, 1));
+
+    vec3 light = normalize(LIGHT_DIRECTION);
+    float diffuse = 0.35f + 0.65f * max(dot(normal, light), 0);
+    float specular = pow(max(dot(normal, normalize(light + vec3(0, 0, 1))), 0), SHININESS);
+    vec3 transmittance = exp(-ABSORPTION * depth_thickness.g);
+    color = vec4(mix(FLUID_COLOR * diffuse, BACKGROUND_COLOR, transmittance) + specular, 1);
+}
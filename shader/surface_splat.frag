@@ -0,0 +1,51 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#version 460
+
+// screen-space surface, first pass. every particle is drawn as a sphere facing the viewer into the half resolution
+// surface target, see application::render_surface. the depth pass keeps the nearest sphere surface in r with the depth
+// test, the thickness pass adds up the sphere thickness in g with additive blending
+layout(constant_id = 3) const bool THICKNESS_PASS = false;
+// sphere radius in normalized device coordinates
+layout(constant_id = 5) const float SPHERE_RADIUS = 0.01f;
+
+layout(location = 0) out vec2 depth_thickness;
+
+void main()
+{
+    vec2 offset = gl_PointCoord * 2 - 1;
+    float radius_squared = dot(offset, offset);
+    if (radius_squared > 1)
+    {
+        discard;
+    }
+    // z component of the sphere normal
+    float normal_z = sqrt(1 - radius_squared);
+    if (THICKNESS_PASS)
+    {
+        depth_thickness = vec2(0, 2 * SPHERE_RADIUS * normal_z);
+        return;
+    }
+    // window depth is half the normalized device depth
+    float depth = gl_FragCoord.z - 0.5f * SPHERE_RADIUS * normal_z;
+    gl_FragDepth = depth;
+    depth_thickness = vec2(depth, 0);
+}
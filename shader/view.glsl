@@ -0,0 +1,65 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// the view of particle.vert, shared with the passes that have to agree with what it draws: cull.comp and
+// density_splat.comp. included through GL_GOOGLE_include_directive after the includer defines particle_vector
+
+// ensemble mode draws every simulation in its own tile
+layout(constant_id = 7) const uint ENSEMBLE_SIZE = 1;
+layout(constant_id = 8) const uint MEMBER_PARTICLES = 0;
+
+// camera, mirrors view_parameters in application.hpp
+layout(std140, binding = 1) uniform view_block
+{
+    vec2 view_center;
+    float view_zoom;
+};
+
+// tiles per row and per column of the ensemble grid
+uint ensemble_columns()
+{
+    return uint(ceil(sqrt(float(ENSEMBLE_SIZE))));
+}
+
+// normalized device coordinates of particle i in xy, its depth in z
+vec3 view_project(particle_vector position, uint i)
+{
+#ifdef SPH_3D
+    // fixed view of the [-1, 1] box, turned about the y axis and tilted towards the viewer
+    const float yaw = 0.6f;
+    const float pitch = 0.4f;
+    vec3 p = vec3(cos(yaw) * position.x + sin(yaw) * position.z, position.y, -sin(yaw) * position.x + cos(yaw) * position.z);
+    p = vec3(p.x, cos(pitch) * p.y - sin(pitch) * p.z, sin(pitch) * p.y + cos(pitch) * p.z);
+    // orthographic, scaled so the corners of the box stay on screen
+    vec3 ndc = vec3(0.55f * p.xy, 0.5f * p.z);
+#else
+    vec3 ndc = vec3(position, 0);
+#endif
+    if (ENSEMBLE_SIZE > 1)
+    {
+        // square grid of tiles, the first simulation at the top left
+        uint columns = ensemble_columns();
+        uint member = i / MEMBER_PARTICLES;
+        vec2 tile = vec2(member % columns, columns - 1 - member / columns);
+        ndc.xy = (ndc.xy + 1 + 2 * tile) / columns - 1;
+    }
+    ndc.xy = (ndc.xy - view_center) * view_zoom;
+    return ndc;
+}
@@ -19,18 +19,24 @@
 // SOFTWARE.
 
 #include "application.hpp"
+#include "log.hpp"
+
+#ifdef SPH_EGL
+#include <EGL/egl.h>
+#endif
 
 #include <cmath>
+#include <cstddef>
 #include <string>
 #include <algorithm>
 #include <exception>
-#include <iostream>
-#include <sstream>
+#include <cstdio>
 #include <fstream>
 #include <iomanip>
 #include <thread>
 
-#ifdef _DEBUG
+// performance messages are only counted into the metrics, data points to the counter. everything else goes through the
+// asynchronous logger, so synchronous debug output does not hold up the driver on console output
 void APIENTRY gl_debug_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* msg, const void* data)
 {
     const char* source_str;
@@ -108,34 +114,153 @@ void APIENTRY gl_debug_callback(GLenum source, GLenum type, GLuint id, GLenum se
         severity_str = "?";
         break;
     }
-    std::cout << "[" << source_str << "][" << type_str << "][" << id << "][" << severity_str << "] " << msg << std::endl;
+    sph::log_level level = sph::log_level::debug;
+    if (type == GL_DEBUG_TYPE_PERFORMANCE)
+    {
+        const_cast<std::atomic_uint64_t*>(static_cast<const std::atomic_uint64_t*>(data))->fetch_add(1, std::memory_order_relaxed);
+    }
+    else if (type == GL_DEBUG_TYPE_ERROR || severity == GL_DEBUG_SEVERITY_HIGH)
+    {
+        level = sph::log_level::error;
+    }
+    else if (severity == GL_DEBUG_SEVERITY_MEDIUM)
+    {
+        level = sph::log_level::warning;
+    }
+    else if (severity == GL_DEBUG_SEVERITY_LOW)
+    {
+        level = sph::log_level::info;
+    }
+    sph::log_message(level, "[%s][%s][%u][%s] %s", source_str, type_str, id, severity_str, msg);
 }
+
+// debug builds get every message synchronously. release builds only ask for errors and performance warnings, which the
+// driver may report from any thread
+void enable_debug_output(std::atomic_uint64_t* performance_message_count)
+{
+    glEnable(GL_DEBUG_OUTPUT);
+#ifdef _DEBUG
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+#else
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+    glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_ERROR, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+    glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_PERFORMANCE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
 #endif
+    glDebugMessageCallback(gl_debug_callback, performance_message_count);
+}
 
 namespace sph
 {
 
 application::application()
 {
+    scene = default_scene(0, false);
     initialize_window();
     initialize_opengl();
 }
 
-application::application(int64_t scene_id)
+application::application(const application_options& options)
 {
-    this->scene_id = scene_id;
+    scene = options.scene_path.empty() ? default_scene(options.scene_id, options.three_dimensional) : load_scene(options.scene_path);
+    this->solver = options.solver.value_or(scene.solver.value_or(solver_type::sph));
+    this->sleeping = options.sleeping;
+    this->three_dimensional = scene.dimensions == 3;
+    this->ensemble_size = std::max(options.ensemble_size, 1u);
+    this->sweep = options.sweep;
+    this->stats_target = options.stats;
+    this->stats_interval = options.stats_interval;
+    this->trace_path = options.trace_path;
+    this->metrics_path = options.metrics_path;
+    this->metrics_port = options.metrics_port;
+    this->use_simulation_thread = options.simulation_thread;
+    this->capture_path = options.capture_path;
+    this->snapshot_path = options.snapshot_path;
+    this->snapshot_interval = std::max(options.snapshot_interval, 1u);
+    this->snapshot_delay = options.snapshot_delay;
+    this->steps_per_frame = std::max(options.steps_per_frame, 1u);
+    this->windowless = options.windowless;
+    this->headless = options.headless || windowless;
+    this->map_particles = options.mapped_particles;
+    this->shader_directory = options.shader_directory;
+    this->frame_limit = options.frame_limit;
+    this->style = options.style;
+    this->surface_scale = std::clamp(options.surface_scale, 0.125f, 1.f);
+    this->surface_filter_radius = options.surface_filter_radius;
+    this->contour_resolution = options.contour_resolution == 0 ? 0 : std::max(options.contour_resolution, 2u);
+    this->contour_interval = std::max(options.contour_interval, 1u);
+    this->coloring = options.coloring;
+    this->colormap = options.colormap;
+    this->color_min = options.color_min;
+    this->color_max = options.color_max;
+    pacer.initialize(capture_path.empty() && !headless ? options.present_rate : 0);
+    if (use_simulation_thread && (!capture_path.empty() || headless))
+    {
+        // a captured frame has to show a known step, and without a window there is nothing to decouple from
+        log_message(log_level::info, "capture and headless runs step in lockstep");
+        use_simulation_thread = false;
+    }
+    if (use_simulation_thread && map_particles)
+    {
+        // the host reads the particles between steps it issues itself
+        log_message(log_level::info, "mapped particles step in lockstep");
+        use_simulation_thread = false;
+    }
+    if (sweep && ensemble_size < 2)
+    {
+        throw std::runtime_error("a parameter sweep needs an ensemble of at least two simulations");
+    }
+    if (ensemble_size > 1)
+    {
+        // particles are assigned to their simulation by index, which compaction and emitters would break
+        if (!scene.emitters.empty() || !scene.sinks.empty())
+        {
+            throw std::runtime_error("ensemble mode needs a scene without emitters and sinks");
+        }
+        member_particle_count = scene.particle_count;
+        std::vector<fluid_block> member_blocks;
+        for (uint32_t member = 0; member < ensemble_size; member++)
+        {
+            for (fluid_block block : scene.blocks)
+            {
+                block.count.w += member * member_particle_count;
+                member_blocks.push_back(block);
+            }
+        }
+        scene.blocks = std::move(member_blocks);
+        scene.particle_count = member_particle_count * ensemble_size;
+        scene.particle_capacity = scene.particle_count;
+    }
     initialize_window();
     initialize_opengl();
 }
 
 application::~application()
 {
+    if (simulation_thread.joinable())
+    {
+        simulation_running = false;
+        simulation_thread.join();
+    }
     destroy_opengl();
     destroy_window();
 }
 
 void application::destroy_window()
 {
+#ifdef SPH_EGL
+    if (egl_context != nullptr)
+    {
+        // the display is shared by every context of the process, it stays initialized
+        eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(egl_display, egl_context);
+        return;
+    }
+#endif
+    if (simulation_window != nullptr)
+    {
+        glfwDestroyWindow(simulation_window);
+    }
     if (window != nullptr)
     {
         glfwDestroyWindow(window);
@@ -145,35 +270,183 @@ void application::destroy_window()
 
 void application::destroy_opengl()
 {
+    capture.finish();
+    snapshots.finish();
+    metrics.stop();
+    if (frame_fence != nullptr)
+    {
+        glDeleteSync(frame_fence);
+    }
+    if (state_readback_fence != nullptr)
+    {
+        glDeleteSync(state_readback_fence);
+    }
+    glDeleteBuffers(1, &state_readback_buffer_handle);
+    if (tracer.enabled())
+    {
+        // let the last gpu spans finish so they make it into the trace
+        glFinish();
+        write_trace();
+    }
+    tracer.destroy();
     glDeleteProgram(render_program_handle);
     glDeleteProgram(compute_program_handle[0]);
     glDeleteProgram(compute_program_handle[1]);
     glDeleteProgram(compute_program_handle[2]);
+    glDeleteProgram(update_indirect_program_handle);
+    glDeleteProgram(mark_sinks_program_handle);
+    glDeleteProgram(scan_local_program_handle);
+    glDeleteProgram(scan_blocks_program_handle);
+    glDeleteProgram(scan_add_program_handle);
+    glDeleteProgram(compact_scatter_program_handle);
+    glDeleteProgram(compact_gather_program_handle);
+    glDeleteProgram(emit_program_handle);
+    glDeleteProgram(spawn_program_handle);
+    glDeleteProgram(predict_position_program_handle);
+    glDeleteProgram(predict_density_program_handle);
+    glDeleteProgram(predict_force_program_handle);
+    glDeleteProgram(pcisph_check_program_handle);
+    glDeleteProgram(grid_count_program_handle);
+    glDeleteProgram(grid_sort_program_handle);
+    glDeleteProgram(pbf_predict_program_handle);
+    glDeleteProgram(pbf_lambda_program_handle);
+    glDeleteProgram(pbf_delta_program_handle);
+    glDeleteProgram(pbf_apply_program_handle);
+    glDeleteProgram(pbf_velocity_program_handle);
+    glDeleteProgram(pbf_finalize_program_handle);
+    glDeleteProgram(sleep_mark_program_handle);
+    glDeleteProgram(sleep_cells_program_handle);
+    glDeleteProgram(sleep_gather_program_handle);
+    glDeleteProgram(overlay_program_handle);
+    glDeleteProgram(surface_depth_program_handle);
+    glDeleteProgram(surface_thickness_program_handle);
+    glDeleteProgram(surface_filter_program_handle[0]);
+    glDeleteProgram(surface_filter_program_handle[1]);
+    glDeleteProgram(surface_composite_program_handle);
+    glDeleteFramebuffers(1, &surface_framebuffer_handle);
+    glDeleteTextures(2, surface_texture_handle);
+    glDeleteTextures(1, &surface_depth_texture_handle);
+    glDeleteProgram(contour_splat_program_handle);
+    glDeleteProgram(contour_extract_program_handle);
+    glDeleteProgram(contour_program_handle);
+    glDeleteBuffers(1, &contour_buffer_handle);
+    glDeleteBuffers(1, &contour_grid_buffer_handle);
+    glDeleteProgram(density_splat_program_handle);
+    glDeleteProgram(density_composite_program_handle);
+    glDeleteTextures(2, density_texture_handle);
+    glDeleteBuffers(1, &density_buffer_handle);
 
     glDeleteVertexArrays(1, &particle_position_vao_handle);
+    glDeleteProgram(cull_program_handle);
+    glDeleteBuffers(1, &view_buffer_handle);
+    glDeleteBuffers(1, &cull_buffer_handle);
     glDeleteBuffers(1, &packed_particles_buffer_handle);
+    glDeleteBuffers(1, &packed_particles_scratch_buffer_handle);
+    glDeleteBuffers(1, &simulation_state_buffer_handle);
+    glDeleteBuffers(1, &attribute_layout_buffer_handle);
+    glDeleteBuffers(1, &compaction_buffer_handle);
+    glDeleteBuffers(1, &emitter_buffer_handle);
+    glDeleteBuffers(1, &sink_buffer_handle);
+    glDeleteBuffers(1, &solver_buffer_handle);
+    glDeleteBuffers(1, &grid_buffer_handle);
+    glDeleteBuffers(1, &sleep_buffer_handle);
+    glDeleteBuffers(1, &parameter_buffer_handle);
+    glDeleteBuffers(1, &member_parameter_buffer_handle);
+    glDeleteBuffers(1, &overlay_buffer_handle);
+    glDeleteBuffers(1, &render_frame_buffer_handle);
+    for (const render_frame& frame : render_frames)
+    {
+        glDeleteSync(frame.ready);
+        glDeleteSync(frame.released);
+    }
+    stats.destroy();
+    render_stats.destroy();
+    glDeleteTextures(1, &signed_distance_field_texture_handle);
 
 }
 
 void application::run()
 {
+    if (windowless)
+    {
+        throw std::runtime_error("a windowless application has nothing to show, step it instead");
+    }
     // to measure performance
     std::thread(
         [this]()
         {
             std::this_thread::sleep_for(std::chrono::seconds(20));
-            std::cout << "[INFO] frame count after 20 seconds: " << frame_number << std::endl;
+            const uint64_t frame_count = frame_number;
+            log_message(log_level::info, "frame count after 20 seconds: %llu", static_cast<unsigned long long>(frame_count));
+            log_message(log_level::info, "simulated time after 20 seconds with the %s solver: %g s", solver_name(), simulated_seconds.load());
         }
     ).detach();
 
-    while (!glfwWindowShouldClose(window))
+    if (simulation_window == nullptr)
+    {
+        while (!glfwWindowShouldClose(window) && (frame_limit == 0 || rendered_frames < frame_limit))
+        {
+            main_loop();
+        }
+        return;
+    }
+    simulation_running = true;
+    simulation_thread = std::thread(&application::simulation_loop, this);
+    while (!glfwWindowShouldClose(window) && (frame_limit == 0 || rendered_frames < frame_limit))
+    {
+        present_frame();
+    }
+    simulation_running = false;
+    simulation_thread.join();
+    if (simulation_error)
     {
-        main_loop();
+        std::rethrow_exception(simulation_error);
     }
 }
 
 void application::initialize_window()
 {
+#ifdef SPH_EGL
+    if (windowless)
+    {
+        // surfaceless, the steps only touch buffers
+        EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+        {
+            throw std::runtime_error("EGL initialization failed");
+        }
+        const EGLint config_attributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLConfig config = nullptr;
+        EGLint config_count = 0;
+        if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(display, config_attributes, &config, 1, &config_count) || config_count == 0)
+        {
+            throw std::runtime_error("EGL has no desktop OpenGL config");
+        }
+        const EGLint context_attributes[] =
+        {
+            EGL_CONTEXT_MAJOR_VERSION, 4,
+            EGL_CONTEXT_MINOR_VERSION, 6,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#ifdef _DEBUG
+            EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+#endif
+            EGL_NONE
+        };
+        EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+        if (context == EGL_NO_CONTEXT)
+        {
+            throw std::runtime_error("EGL context creation failed, OpenGL 4.6 is needed");
+        }
+        egl_display = display;
+        egl_context = context;
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+        {
+            eglDestroyContext(display, context);
+            throw std::runtime_error("EGL context without a surface cannot be made current, EGL_KHR_surfaceless_context is needed");
+        }
+        return;
+    }
+#endif
     if (!glfwInit())
     {
         throw std::runtime_error("glfw initialization failed");
@@ -181,15 +454,32 @@ void application::initialize_window()
 #ifdef _DEBUG
     glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
 #endif
+    if (headless)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
     window = glfwCreateWindow(1000, 1000, "", nullptr, nullptr);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
     if (!window)
     {
         glfwTerminate();
         throw std::runtime_error("window creation failed");
     }
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(0); // set vertical sync off
-                            // pass Application pointer to the callback using GLFW user pointer
+    // in lockstep vertical sync would hold back the simulation, with a simulation thread it only paces the presentation
+    glfwSwapInterval(use_simulation_thread ? 1 : 0);
+    if (use_simulation_thread)
+    {
+        // contexts need a window in glfw, the simulation context gets a hidden one and shares the objects of the window context
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        simulation_window = glfwCreateWindow(1, 1, "", nullptr, window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (!simulation_window)
+        {
+            throw std::runtime_error("simulation context creation failed");
+        }
+    }
+    // pass Application pointer to the callback using GLFW user pointer
     glfwSetWindowUserPointer(window, reinterpret_cast<void*>(this));
     // set key callback
     auto key_callback = [](GLFWwindow* window, int key, int scancode, int action, int mode)
@@ -203,9 +493,56 @@ void application::initialize_window()
         {
             glfwSetWindowShouldClose(window, GLFW_TRUE);
         }
+        if (key == GLFW_KEY_T && action == GLFW_PRESS && app_ptr->tracer.enabled())
+        {
+            app_ptr->write_trace();
+        }
+        if (key == GLFW_KEY_R && action == GLFW_PRESS)
+        {
+            app_ptr->view = { glm::vec2(0, 0), 1 };
+            app_ptr->view_changed = true;
+        }
+    };
+    // camera, the wheel zooms about the cursor and dragging with the left button pans
+    auto scroll_callback = [](GLFWwindow* window, double x_offset, double y_offset)
+    {
+        auto app_ptr = reinterpret_cast<sph::application*>(glfwGetWindowUserPointer(window));
+        view_parameters& view = app_ptr->view;
+        const glm::vec2 cursor = app_ptr->cursor_position();
+        const float zoom = std::clamp(view.zoom * std::pow(1.2f, static_cast<float>(y_offset)), SPH_ZOOM_MIN, SPH_ZOOM_MAX);
+        // the point under the cursor stays in place
+        view.center.x += cursor.x / view.zoom - cursor.x / zoom;
+        view.center.y += cursor.y / view.zoom - cursor.y / zoom;
+        view.zoom = zoom;
+        app_ptr->view_changed = true;
+    };
+    auto mouse_button_callback = [](GLFWwindow* window, int button, int action, int mods)
+    {
+        auto app_ptr = reinterpret_cast<sph::application*>(glfwGetWindowUserPointer(window));
+        if (button == GLFW_MOUSE_BUTTON_LEFT)
+        {
+            app_ptr->panning = action == GLFW_PRESS;
+            app_ptr->pan_cursor = app_ptr->cursor_position();
+        }
+    };
+    auto cursor_position_callback = [](GLFWwindow* window, double x, double y)
+    {
+        auto app_ptr = reinterpret_cast<sph::application*>(glfwGetWindowUserPointer(window));
+        if (!app_ptr->panning)
+        {
+            return;
+        }
+        const glm::vec2 cursor = app_ptr->cursor_position();
+        app_ptr->view.center.x -= (cursor.x - app_ptr->pan_cursor.x) / app_ptr->view.zoom;
+        app_ptr->view.center.y -= (cursor.y - app_ptr->pan_cursor.y) / app_ptr->view.zoom;
+        app_ptr->pan_cursor = cursor;
+        app_ptr->view_changed = true;
     };
 
     glfwSetKeyCallback(window, key_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetCursorPosCallback(window, cursor_position_callback);
 }
 
 void application::initialize_opengl()
@@ -216,131 +553,605 @@ void application::initialize_opengl()
     if (!gl3wIsSupported(4, 6)) {
         throw std::runtime_error("OpenGL 4.6 is not supported");
     }
+    // the simulation objects and bindings are set up in the simulation context, initialize_rendering switches back
+    if (simulation_window != nullptr)
+    {
+        glfwMakeContextCurrent(simulation_window);
+    }
     // get version info 
-    std::cout << "[INFO] OpenGL vendor: " << glGetString(GL_VENDOR) << std::endl << "[INFO] OpenGL renderer: " << glGetString(GL_RENDERER) << std::endl << "[INFO] OpenGL version: " << glGetString(GL_VERSION) << std::endl;
+    log_message(log_level::info, "OpenGL vendor: %s", reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+    log_message(log_level::info, "OpenGL renderer: %s", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    log_message(log_level::info, "OpenGL version: %s", reinterpret_cast<const char*>(glGetString(GL_VERSION)));
 
-#ifdef _DEBUG
-    glEnable(GL_DEBUG_OUTPUT);
-    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-    glDebugMessageCallback(gl_debug_callback, nullptr);
-    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
-#endif
-    glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    enable_debug_output(&gl_performance_messages);
+    tracer.initialize(!trace_path.empty());
 
-    uint32_t vertex_shader_handle = compile_shader("particle.vert.spv", GL_VERTEX_SHADER);
-    uint32_t fragment_shader_handle = compile_shader("particle.frag.spv", GL_FRAGMENT_SHADER);
-    render_program_handle = glCreateProgram();
-    glAttachShader(render_program_handle, fragment_shader_handle);
-    glAttachShader(render_program_handle, vertex_shader_handle);
-    glLinkProgram(render_program_handle);
-    check_program_linked(render_program_handle);
-    // delete shaders as we're done with them.
-    glDeleteShader(vertex_shader_handle);
-    glDeleteShader(fragment_shader_handle);
+    // the density, force and integrate kernels are specialized into the building blocks of the selected solver
+    if (solver == solver_type::pcisph)
+    {
+        time_step = SPH_PCISPH_TIME_STEP;
+    }
+    else if (solver == solver_type::pbf)
+    {
+        time_step = SPH_PBF_TIME_STEP;
+    }
+    if ((three_dimensional || ensemble_size > 1) && solver == solver_type::pbf)
+    {
+        log_message(log_level::info, "pbf is only supported in single 2d simulations, using sph");
+        solver = solver_type::sph;
+        time_step = SPH_TIME_STEP;
+    }
+    time_step = scene.time_step.value_or(time_step);
+    if (sleeping && solver != solver_type::sph)
+    {
+        // the iterative solvers move every particle every iteration
+        log_message(log_level::info, "sleeping cells are only supported by the sph solver");
+        sleeping = false;
+    }
+    if (sleeping && ensemble_size > 1)
+    {
+        log_message(log_level::info, "sleeping cells are not supported in ensemble mode");
+        sleeping = false;
+    }
 
-    uint32_t compute_shader_handle;
-    compute_shader_handle = compile_shader("compute_density_pressure.comp.spv", GL_COMPUTE_SHADER);
-    compute_program_handle[0] = glCreateProgram();
-    glAttachShader(compute_program_handle[0], compute_shader_handle);
-    glLinkProgram(compute_program_handle[0]);
-    check_program_linked(render_program_handle);
-    glDeleteShader(compute_shader_handle);
+    // numeric parameters are read from a uniform buffer, so they can change between steps without relinking
+    glCreateBuffers(1, &parameter_buffer_handle);
+    glNamedBufferStorage(parameter_buffer_handle, sizeof(simulation_parameters), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, parameter_buffer_handle);
+    simulation_parameters initial_parameters {};
+    initial_parameters.gravity = scene.gravity;
+    initial_parameters.domain_min = scene.domain_min;
+    initial_parameters.domain_max = scene.domain_max;
+    initial_parameters.time_step = time_step;
+    initial_parameters.particle_mass = scene.particle_mass.value_or(three_dimensional ? SPH_PARTICLE_MASS_3D : SPH_PARTICLE_MASS);
+    initial_parameters.rest_density = scene.rest_density;
+    initial_parameters.stiffness = scene.stiffness;
+    initial_parameters.viscosity = scene.viscosity;
+    set_parameters(initial_parameters);
+    if (ensemble_size > 1)
+    {
+        // one parameter record per simulation, read by the sph kernels instead of the uniform buffer
+        glCreateBuffers(1, &member_parameter_buffer_handle);
+        glNamedBufferStorage(member_parameter_buffer_handle, sizeof(simulation_parameters) * ensemble_size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 22, member_parameter_buffer_handle);
+        ensemble_parameters.assign(ensemble_size, current_parameters);
+        for (uint32_t member = 0; member < ensemble_size; member++)
+        {
+            simulation_parameters record = current_parameters;
+            if (sweep)
+            {
+                const float value = sweep->first + (sweep->last - sweep->first) * member / (ensemble_size - 1);
+                if (sweep->parameter == "stiffness")
+                {
+                    record.stiffness = value;
+                }
+                else if (sweep->parameter == "viscosity")
+                {
+                    record.viscosity = value;
+                }
+                else if (sweep->parameter == "rest_density")
+                {
+                    record.rest_density = value;
+                }
+                else if (sweep->parameter == "mass")
+                {
+                    record.particle_mass = value;
+                }
+                else if (sweep->parameter == "gravity")
+                {
+                    record.gravity.y = value;
+                }
+                else
+                {
+                    throw std::runtime_error("unknown sweep parameter " + sweep->parameter);
+                }
+            }
+            set_member_parameters(member, record);
+        }
+        log_message(log_level::info, "ensemble of %u simulations with %u particles each", ensemble_size, member_particle_count);
+    }
 
-    compute_shader_handle = compile_shader("compute_force.comp.spv", GL_COMPUTE_SHADER);
-    compute_program_handle[1] = glCreateProgram();
-    glAttachShader(compute_program_handle[1], compute_shader_handle);
-    glLinkProgram(compute_program_handle[1]);
-    check_program_linked(render_program_handle);
-    glDeleteShader(compute_shader_handle);
+    // only the choices between code paths are specialization constants
+    std::vector<specialization_constant> solver_constants
+    {
+        { 0, static_cast<GLuint>(solver) }, // SOLVER
+        { 1, 0 }, // PREDICTED
+        { 6, sleeping ? 1u : 0u }, // SLEEPING
+        { 7, ensemble_size }, // ENSEMBLE_SIZE
+        { 8, member_particle_count }, // MEMBER_PARTICLES
+    };
+    compute_program_handle[0] = create_compute_program("compute_density_pressure.comp.spv", solver_constants);
+    compute_program_handle[1] = create_compute_program("compute_force.comp.spv", solver_constants);
+    compute_program_handle[2] = create_compute_program("integrate.comp.spv", solver_constants);
+    if (solver == solver_type::pcisph)
+    {
+        std::vector<specialization_constant> predicted_constants = solver_constants;
+        predicted_constants[1].value = 1;
+        predict_position_program_handle = create_compute_program("integrate.comp.spv", predicted_constants);
+        predict_density_program_handle = create_compute_program("compute_density_pressure.comp.spv", predicted_constants);
+        predict_force_program_handle = create_compute_program("compute_force.comp.spv", predicted_constants);
+        pcisph_check_program_handle = create_compute_program("pcisph_check.comp.spv", solver_constants);
+    }
+    // pbf bins the predicted positions
+    std::vector<specialization_constant> grid_constants = solver_constants;
+    grid_constants[1].value = solver == solver_type::pbf ? 1 : 0;
+    grid_count_program_handle = create_compute_program("grid_count.comp.spv", grid_constants);
+    grid_sort_program_handle = create_compute_program("grid_sort.comp.spv");
+    if (sleeping)
+    {
+        sleep_mark_program_handle = create_compute_program("sleep_mark.comp.spv");
+        sleep_cells_program_handle = create_compute_program("sleep_cells.comp.spv");
+        sleep_gather_program_handle = create_compute_program("sleep_gather.comp.spv");
+    }
+    if (solver == solver_type::pbf)
+    {
+        pbf_predict_program_handle = create_compute_program("pbf_predict.comp.spv", solver_constants);
+        pbf_lambda_program_handle = create_compute_program("pbf_lambda.comp.spv", solver_constants);
+        pbf_delta_program_handle = create_compute_program("pbf_delta.comp.spv", solver_constants);
+        pbf_apply_program_handle = create_compute_program("pbf_apply.comp.spv", solver_constants);
+        pbf_velocity_program_handle = create_compute_program("pbf_velocity.comp.spv", solver_constants);
+        pbf_finalize_program_handle = create_compute_program("pbf_finalize.comp.spv", solver_constants);
+    }
+    update_indirect_program_handle = create_compute_program("update_indirect.comp.spv");
 
-    compute_shader_handle = compile_shader("integrate.comp.spv", GL_COMPUTE_SHADER);
-    compute_program_handle[2] = glCreateProgram();
-    glAttachShader(compute_program_handle[2], compute_shader_handle);
-    glLinkProgram(compute_program_handle[2]);
-    check_program_linked(render_program_handle);
-    glDeleteShader(compute_shader_handle);
+    mark_sinks_program_handle = create_compute_program("mark_sinks.comp.spv");
+    scan_local_program_handle = create_compute_program("scan_local.comp.spv");
+    scan_blocks_program_handle = create_compute_program("scan_blocks.comp.spv");
+    scan_add_program_handle = create_compute_program("scan_add.comp.spv");
+    compact_scatter_program_handle = create_compute_program("compact_scatter.comp.spv");
+    compact_gather_program_handle = create_compute_program("compact_gather.comp.spv");
+    emit_program_handle = create_compute_program("emit.comp.spv");
+    spawn_program_handle = create_compute_program("spawn_blocks.comp.spv");
+
+    // every per-particle buffer is allocated once for the capacity rather than the live population, so emitters never
+    // reallocate or rebind anything mid-run. the cost is memory for particles that may never exist, the packed arrays
+    // are logged below and the solver scratch arrays add roughly as much again.
+    // round the capacity up to whole work groups, the prefix sum reads the tail of the last work group
+    particle_capacity = (scene.particle_capacity + SPH_WORK_GROUP_SIZE - 1) / SPH_WORK_GROUP_SIZE * SPH_WORK_GROUP_SIZE;
+
+    // vector attributes are vec2 in 2d and padded to vec4 in 3d, particle_vector in the shaders
+    const GLsizeiptr vector_size = three_dimensional ? sizeof(glm::vec4) : sizeof(glm::vec2);
+    // one array per attribute in the packed buffer, array i is bound to ssbo binding i
+    const GLsizeiptr attribute_element_size[] =
+    {
+        vector_size, // position
+        vector_size, // velocity
+        vector_size, // force
+        sizeof(float), // density
+        sizeof(float), // pressure
+    };
+    GLint ssbo_offset_alignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssbo_offset_alignment);
+    auto align_ssbo_offset = [ssbo_offset_alignment](GLsizeiptr offset)
+    {
+        return (offset + ssbo_offset_alignment - 1) / ssbo_offset_alignment * ssbo_offset_alignment;
+    };
+    // ssbo offsets and sizes
+    std::vector<particle_attribute> attributes;
+    GLsizeiptr packed_buffer_size = 0;
+    for (GLsizeiptr element_size : attribute_element_size)
+    {
+        packed_buffer_size = align_ssbo_offset(packed_buffer_size);
+        attributes.push_back({ static_cast<uint32_t>(packed_buffer_size / sizeof(uint32_t)), static_cast<uint32_t>(element_size / sizeof(uint32_t)) });
+        packed_buffer_size += element_size * particle_capacity;
+    }
+
+    // every attribute starts at zero, spawn_fluid_blocks fills in the positions
+    constexpr GLbitfield map_flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &packed_particles_buffer_handle);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, packed_particles_buffer_handle);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, packed_buffer_size, nullptr, GL_DYNAMIC_STORAGE_BIT | (map_particles ? map_flags : 0));
+    const GLuint zero = 0;
+    glClearNamedBufferData(packed_particles_buffer_handle, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    if (map_particles)
+    {
+        particle_mapping = glMapNamedBufferRange(packed_particles_buffer_handle, 0, packed_buffer_size, map_flags);
+    }
+    log_message(log_level::info, "particle capacity %u of which %u spawned, %.1f MiB of particle arrays", particle_capacity, scene.particle_count,
+        packed_buffer_size / (1024.0 * 1024.0));
+
+    // bindings
+    for (GLuint binding = 0; binding < attributes.size(); binding++)
+    {
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, packed_particles_buffer_handle,
+            attributes[binding].offset * sizeof(uint32_t), attributes[binding].size * sizeof(uint32_t) * particle_capacity);
+    }
+    particle_attributes = attributes;
+
+    // the particle count lives on the gpu from here on, every dispatch and draw reads its size from this buffer
+    const simulation_state state = initial_state();
+    glGenBuffers(1, &simulation_state_buffer_handle);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, simulation_state_buffer_handle);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(simulation_state), &state, GL_DYNAMIC_STORAGE_BIT);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, simulation_state_buffer_handle);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, simulation_state_buffer_handle);
+    update_indirect_commands();
+    spawn_fluid_blocks();
+
+    // stream compaction moves every attribute array through the scratch buffer as raw words,
+    // so it only needs the attribute layout instead of one binding per array
+    glGenBuffers(1, &attribute_layout_buffer_handle);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, attribute_layout_buffer_handle);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(particle_attribute) * attributes.size(), attributes.data(), 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, packed_particles_buffer_handle);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, attribute_layout_buffer_handle);
+    if (!scene.sinks.empty())
+    {
+        glGenBuffers(1, &packed_particles_scratch_buffer_handle);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, packed_particles_scratch_buffer_handle);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, packed_buffer_size, nullptr, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, packed_particles_scratch_buffer_handle);
+
+        // compaction flags, scan and scan block sums
+        const GLsizeiptr flag_size = sizeof(uint32_t) * particle_capacity;
+        const GLsizeiptr scan_offset = align_ssbo_offset(flag_size);
+        const GLsizeiptr scan_size = sizeof(uint32_t) * particle_capacity;
+        const GLsizeiptr block_sum_offset = align_ssbo_offset(scan_offset + scan_size);
+        const GLsizeiptr block_sum_size = sizeof(uint32_t) * particle_capacity / SPH_WORK_GROUP_SIZE;
+        glGenBuffers(1, &compaction_buffer_handle);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, compaction_buffer_handle);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, block_sum_offset + block_sum_size, nullptr, 0);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 11, compaction_buffer_handle, 0, flag_size);
+        // the scan bindings are shared with the grid build, run_prefix_sum binds them per use
+        compaction_scan_range = { compaction_buffer_handle, scan_offset, scan_size };
+        compaction_block_sum_range = { compaction_buffer_handle, block_sum_offset, block_sum_size };
+
+        glGenBuffers(1, &sink_buffer_handle);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, sink_buffer_handle);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(sink) * scene.sinks.size(), scene.sinks.data(), 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, sink_buffer_handle);
+    }
+    if (!scene.emitters.empty())
+    {
+        uint32_t emitter_slot_count = 0;
+        for (auto& e : scene.emitters)
+        {
+            e.interval = std::max(e.interval, 1u);
+            emitter_slot_count += e.particles_per_row;
+        }
+        num_emit_work_groups = (emitter_slot_count + SPH_WORK_GROUP_SIZE - 1) / SPH_WORK_GROUP_SIZE;
+        glGenBuffers(1, &emitter_buffer_handle);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, emitter_buffer_handle);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(emitter) * scene.emitters.size(), scene.emitters.data(), 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, emitter_buffer_handle);
+    }
+
+    // the 3d kernels find the walls of the box analytically
+    if (!three_dimensional)
+    {
+        create_signed_distance_field();
+    }
+
+    // uniform grid for the neighbor search, rebuilt every step with a counting sort
+    {
+        const GLsizeiptr particle_cell_size = sizeof(glm::uvec2) * particle_capacity;
+        // the cell counts are scanned in whole work groups
+        // every simulation of an ensemble has its own copy of the grid
+        const uint32_t grid_cell_count = SPH_GRID_RESOLUTION * SPH_GRID_RESOLUTION * (three_dimensional ? SPH_GRID_RESOLUTION : 1) * ensemble_size;
+        num_grid_work_groups = (grid_cell_count + SPH_WORK_GROUP_SIZE - 1) / SPH_WORK_GROUP_SIZE;
+        const GLsizeiptr cell_start_offset = align_ssbo_offset(particle_cell_size);
+        const GLsizeiptr cell_start_size = sizeof(uint32_t) * num_grid_work_groups * SPH_WORK_GROUP_SIZE;
+        const GLsizeiptr block_sum_offset = align_ssbo_offset(cell_start_offset + cell_start_size);
+        const GLsizeiptr block_sum_size = sizeof(uint32_t) * num_grid_work_groups;
+        const GLsizeiptr sorted_index_offset = align_ssbo_offset(block_sum_offset + block_sum_size);
+        const GLsizeiptr sorted_index_size = sizeof(uint32_t) * particle_capacity;
+        glGenBuffers(1, &grid_buffer_handle);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, grid_buffer_handle);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, sorted_index_offset + sorted_index_size, nullptr, 0);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 16, grid_buffer_handle, 0, particle_cell_size);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 17, grid_buffer_handle, cell_start_offset, cell_start_size);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 18, grid_buffer_handle, sorted_index_offset, sorted_index_size);
+        grid_scan_range = { grid_buffer_handle, cell_start_offset, cell_start_size };
+        grid_block_sum_range = { grid_buffer_handle, block_sum_offset, block_sum_size };
+    }
 
-    // ssbo sizes
-    constexpr ptrdiff_t position_ssbo_size = sizeof(glm::vec2) * SPH_NUM_PARTICLES;
-    constexpr ptrdiff_t velocity_ssbo_size = sizeof(glm::vec2) * SPH_NUM_PARTICLES;
-    constexpr ptrdiff_t force_ssbo_size = sizeof(glm::vec2) * SPH_NUM_PARTICLES;
-    constexpr ptrdiff_t density_ssbo_size = sizeof(float) * SPH_NUM_PARTICLES;
-    constexpr ptrdiff_t pressure_ssbo_size = sizeof(float) * SPH_NUM_PARTICLES;
+    if (sleeping)
+    {
+        // rest state of every grid cell and the list of particles in awake cells
+        const GLsizeiptr cell_sleep_size = sizeof(glm::uvec2) * num_grid_work_groups * SPH_WORK_GROUP_SIZE;
+        const GLsizeiptr active_index_offset = align_ssbo_offset(cell_sleep_size);
+        const GLsizeiptr active_index_size = sizeof(uint32_t) * particle_capacity;
+        glGenBuffers(1, &sleep_buffer_handle);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, sleep_buffer_handle);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, active_index_offset + active_index_size, nullptr, 0);
+        // every cell starts awake
+        const GLuint zero = 0;
+        glClearNamedBufferData(sleep_buffer_handle, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 19, sleep_buffer_handle, 0, cell_sleep_size);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 20, sleep_buffer_handle, active_index_offset, active_index_size);
+    }
 
-    constexpr ptrdiff_t packed_buffer_size = position_ssbo_size + velocity_ssbo_size + force_ssbo_size + density_ssbo_size + pressure_ssbo_size;
-    // ssbo offsets
-    constexpr ptrdiff_t position_ssbo_offset = 0;
-    constexpr ptrdiff_t velocity_ssbo_offset = position_ssbo_size;
-    constexpr ptrdiff_t force_ssbo_offset = velocity_ssbo_offset + velocity_ssbo_size;
-    constexpr ptrdiff_t density_ssbo_offset = force_ssbo_offset + force_ssbo_size;
-    constexpr ptrdiff_t pressure_ssbo_offset = density_ssbo_offset + density_ssbo_size;
+    if (solver == solver_type::pcisph || solver == solver_type::pbf)
+    {
+        // predicted positions and pressure forces only live within a step, so they stay out of the packed buffer.
+        // pbf keeps its position corrections and new velocities in the second array
+        const GLsizeiptr predicted_position_size = vector_size * particle_capacity;
+        const GLsizeiptr pressure_force_offset = align_ssbo_offset(predicted_position_size);
+        const GLsizeiptr pressure_force_size = vector_size * particle_capacity;
+        glGenBuffers(1, &solver_buffer_handle);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, solver_buffer_handle);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, pressure_force_offset + pressure_force_size, nullptr, 0);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 14, solver_buffer_handle, 0, predicted_position_size);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 15, solver_buffer_handle, pressure_force_offset, pressure_force_size);
+    }
 
-    std::vector<glm::vec2> initial_position(SPH_NUM_PARTICLES);
+    stats.initialize(stats_interval);
 
-    // test case 1
-    if (scene_id == 0)
+    if (!metrics_path.empty() || metrics_port != 0)
     {
-        for (auto i = 0, x = 0, y = 0; i < SPH_NUM_PARTICLES; i++)
+        glCreateBuffers(1, &state_readback_buffer_handle);
+        constexpr GLbitfield readback_flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glNamedBufferStorage(state_readback_buffer_handle, sizeof(simulation_state), nullptr, readback_flags);
+        state_readback = static_cast<const simulation_state*>(glMapNamedBufferRange(state_readback_buffer_handle, 0, sizeof(simulation_state), readback_flags));
+        for (GLuint buffer : { packed_particles_buffer_handle, packed_particles_scratch_buffer_handle, compaction_buffer_handle,
+            grid_buffer_handle, sleep_buffer_handle, solver_buffer_handle })
         {
-            initial_position[i].x = -0.625f + SPH_PARTICLE_RADIUS * 2 * x;
-            initial_position[i].y = 1 - SPH_PARTICLE_RADIUS * 2 * y;
-            x++;
-            if (x >= 125)
+            GLint64 size = 0;
+            if (buffer != 0)
             {
-                x = 0;
-                y++;
+                glGetNamedBufferParameteri64v(buffer, GL_BUFFER_SIZE, &size);
             }
+            particle_buffer_bytes += size;
+        }
+        metrics_start = std::chrono::steady_clock::now();
+        next_state_readback = metrics_start;
+        metrics.start(metrics_path, metrics_port, 1);
+        if (!metrics_path.empty())
+        {
+            log_message(log_level::info, "metrics written to %s", metrics_path.c_str());
         }
+        if (metrics_port != 0)
+        {
+            log_message(log_level::info, "metrics served on http://127.0.0.1:%u/metrics", static_cast<unsigned>(metrics_port));
+        }
+    }
+    if (!snapshot_path.empty())
+    {
+        snapshots.start(snapshot_path, particle_source(), snapshot_delay);
+    }
+
+    if (simulation_window != nullptr)
+    {
+        // the window context only uses objects that are complete
+        glFinish();
+        glfwMakeContextCurrent(window);
+    }
+    if (!windowless)
+    {
+        initialize_rendering();
+    }
+}
+
+// state of the window context, which draws the particles
+void application::initialize_rendering()
+{
+    if (simulation_window != nullptr)
+    {
+        enable_debug_output(&gl_performance_messages);
+    }
+    glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+
+    // the render shaders pull the particle arrays by gl_VertexID from the bindings of the simulation kernels. in lockstep
+    // they are the simulation buffers themselves, a simulation thread hands the one array they read over with the positions
+    if (style == render_style::density)
+    {
+        render_frame_attribute_binding = 1;
+    }
+    else if (style == render_style::points && coloring != color_attribute::none)
+    {
+        render_frame_attribute_binding = coloring == color_attribute::speed ? 1 : coloring == color_attribute::density ? 3 : 4;
     }
-    // test case 2
     else
     {
-        for (auto i = 0, x = 0, y = 0; i < SPH_NUM_PARTICLES; i++)
+        coloring = color_attribute::none;
+    }
+    float color_low = color_min;
+    float color_high = color_max;
+    if (color_low == color_high)
+    {
+        const float density = current_parameters.lattice_rest_density;
+        color_low = coloring == color_attribute::density ? 0.5f * density : 0;
+        color_high = coloring == color_attribute::speed ? 2 : coloring == color_attribute::density ? 1.5f * density : 0.1f * current_parameters.stiffness * density;
+    }
+    const std::vector<specialization_constant> render_constants
+    {
+        { 7, ensemble_size }, // ENSEMBLE_SIZE
+        { 8, member_particle_count }, // MEMBER_PARTICLES
+        { 10, static_cast<GLuint>(coloring) }, // COLOR_ATTRIBUTE
+        { 11, static_cast<GLuint>(colormap) }, // COLOR_MAP
+        { 12, std::bit_cast<GLuint>(color_low) }, // COLOR_MIN
+        { 13, std::bit_cast<GLuint>(color_high) }, // COLOR_MAX
+        { 14, 1 }, // CULLED
+    };
+    render_program_handle = create_graphics_program("particle.vert.spv", "particle.frag.spv", render_constants);
+    if (coloring != color_attribute::none)
+    {
+        log_message(log_level::info, "points colored from %g to %g", color_low, color_high);
+    }
+
+    // in lockstep the shaders read the simulation bindings directly. a simulation thread copies completed states into
+    // these slots instead, present_frame points the bindings of this context at the one it draws
+    if (simulation_window != nullptr)
+    {
+        const GLsizeiptr vector_size = three_dimensional ? sizeof(glm::vec4) : sizeof(glm::vec2);
+        render_frame_stride = SPH_RENDER_FRAME_HEADER + (vector_size * particle_capacity + 255) / 256 * 256;
+        if (render_frame_attribute_binding >= 0)
         {
-            initial_position[i].x = -1 + SPH_PARTICLE_RADIUS * 2 * x;
-            initial_position[i].y = -1 + SPH_PARTICLE_RADIUS * 2 * y;
-            x++;
-            if (x >= 100)
-            {
-                x = 0;
-                y++;
-            }
+            const particle_attribute& attribute = particle_attributes[render_frame_attribute_binding];
+            render_frame_attribute_offset = render_frame_stride;
+            render_frame_attribute_source = attribute.offset * sizeof(uint32_t);
+            render_frame_attribute_size = attribute.size * sizeof(uint32_t) * particle_capacity;
+            render_frame_stride += (render_frame_attribute_size + 255) / 256 * 256;
         }
+        glCreateBuffers(1, &render_frame_buffer_handle);
+        glNamedBufferStorage(render_frame_buffer_handle, render_frame_stride * render_frames.size(), nullptr, 0);
+        // zero draw commands, nothing is drawn before the first hand off
+        const GLuint zero = 0;
+        glClearNamedBufferData(render_frame_buffer_handle, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        render_stats.initialize(stats_interval);
     }
-    void* initial_data = std::malloc(packed_buffer_size);
-    std::memset(initial_data, 0, packed_buffer_size);
-    std::memcpy(initial_data, initial_position.data(), position_ssbo_size);
-    glGenBuffers(1, &packed_particles_buffer_handle);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, packed_particles_buffer_handle);
-    glBufferStorage(GL_SHADER_STORAGE_BUFFER, packed_buffer_size, initial_data, GL_DYNAMIC_STORAGE_BIT);
-    std::free(initial_data);
 
+    // the shaders pull everything from storage buffers, draws only need a vao bound
     glGenVertexArrays(1, &particle_position_vao_handle);
     glBindVertexArray(particle_position_vao_handle);
 
-    glBindBuffer(GL_ARRAY_BUFFER, packed_particles_buffer_handle);
-    // bind buffer containing particle position to vao, stride is 0
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-    // enable attribute with binding = 0 (vertex position in the shader) for this vao
-    glEnableVertexAttribArray(0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // camera, and the list of visible particles the point renderers draw
+    glCreateBuffers(1, &view_buffer_handle);
+    glNamedBufferStorage(view_buffer_handle, sizeof(view_parameters), &view, GL_DYNAMIC_STORAGE_BIT);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 1, view_buffer_handle);
+    if (style != render_style::density)
+    {
+        cull_program_handle = create_compute_program("cull.comp.spv",
+            { { 7, ensemble_size }, { 8, member_particle_count } }); // ENSEMBLE_SIZE, MEMBER_PARTICLES
+        GLint ssbo_offset_alignment = 0;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssbo_offset_alignment);
+        cull_index_offset = (sizeof(cull_state) + ssbo_offset_alignment - 1) / ssbo_offset_alignment * ssbo_offset_alignment;
+        glCreateBuffers(1, &cull_buffer_handle);
+        glNamedBufferStorage(cull_buffer_handle, cull_index_offset + sizeof(uint32_t) * particle_capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        const GLuint zero = 0;
+        glClearNamedBufferData(cull_buffer_handle, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        const GLuint instance_count = 1;
+        glNamedBufferSubData(cull_buffer_handle, offsetof(cull_state, draw_instance_count), sizeof(instance_count), &instance_count);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 30, cull_buffer_handle, 0, sizeof(cull_state));
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 31, cull_buffer_handle, cull_index_offset, sizeof(uint32_t) * particle_capacity);
+    }
 
-    // bindings
-    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, packed_particles_buffer_handle, position_ssbo_offset, position_ssbo_size);
-    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, packed_particles_buffer_handle, velocity_ssbo_offset, velocity_ssbo_size);
-    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, packed_particles_buffer_handle, force_ssbo_offset, force_ssbo_size);
-    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 3, packed_particles_buffer_handle, density_ssbo_offset, density_ssbo_size);
-    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 4, packed_particles_buffer_handle, pressure_ssbo_offset, pressure_ssbo_size);
+    if (stats_target == stats_output::overlay)
+    {
+        uint32_t overlay_vertex_shader_handle = compile_shader("overlay.vert.spv", GL_VERTEX_SHADER);
+        uint32_t overlay_fragment_shader_handle = compile_shader("overlay.frag.spv", GL_FRAGMENT_SHADER);
+        overlay_program_handle = glCreateProgram();
+        glAttachShader(overlay_program_handle, overlay_vertex_shader_handle);
+        glAttachShader(overlay_program_handle, overlay_fragment_shader_handle);
+        glLinkProgram(overlay_program_handle);
+        check_program_linked(overlay_program_handle);
+        glDeleteShader(overlay_vertex_shader_handle);
+        glDeleteShader(overlay_fragment_shader_handle);
+        // viewport and text size followed by the characters, mirrors overlay_block (binding 23)
+        const uint32_t overlay_header[4] { static_cast<uint32_t>(window_length), static_cast<uint32_t>(window_height), SPH_STATS_OVERLAY_LINES, SPH_STATS_OVERLAY_COLUMNS };
+        overlay_characters.fill(' ');
+        glCreateBuffers(1, &overlay_buffer_handle);
+        glNamedBufferStorage(overlay_buffer_handle, sizeof(overlay_header) + sizeof(overlay_characters), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glNamedBufferSubData(overlay_buffer_handle, 0, sizeof(overlay_header), overlay_header);
+        glNamedBufferSubData(overlay_buffer_handle, sizeof(overlay_header), sizeof(overlay_characters), overlay_characters.data());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 23, overlay_buffer_handle);
+    }
 
-    glBindVertexArray(particle_position_vao_handle);
+    if (style == render_style::surface)
+    {
+        initialize_surface();
+    }
+    else if (style == render_style::density)
+    {
+        initialize_density();
+    }
+    if (contour_resolution > 0 && three_dimensional)
+    {
+        log_message(log_level::warning, "the contour is only traced in 2d");
+        contour_resolution = 0;
+    }
+    if (contour_resolution > 0)
+    {
+        initialize_contour();
+    }
+    if (!capture_path.empty())
+    {
+        capture.start(capture_path, framebuffer_width, framebuffer_height);
+    }
 
     // set clear color
     glClearColor(0.92f, 0.92f, 0.92f, 1.f);
+}
+
 
+// expands the fluid blocks of the scene into particle positions on the gpu, the block list is only needed for this
+void application::spawn_fluid_blocks()
+{
+    if (scene.blocks.empty())
+    {
+        return;
+    }
+    GLuint fluid_block_buffer_handle = 0;
+    glGenBuffers(1, &fluid_block_buffer_handle);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, fluid_block_buffer_handle);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(fluid_block) * scene.blocks.size(), scene.blocks.data(), 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 21, fluid_block_buffer_handle);
+    glUseProgram(spawn_program_handle);
+    glDispatchComputeIndirect(offsetof(simulation_state, num_work_groups_x));
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    // deletion is deferred until the dispatch has finished
+    glDeleteBuffers(1, &fluid_block_buffer_handle);
 }
 
+// bakes the domain walls and the obstacles into a texture holding the signed distance to the nearest solid surface
+// and its gradient, so boundary handling costs one texture fetch per particle regardless of the geometry.
+// distances are positive in the fluid and negative inside solids.
+void application::create_signed_distance_field()
+{
+    constexpr float texel_size = 2.f / SPH_SDF_RESOLUTION;
+    std::vector<float> distance(SPH_SDF_RESOLUTION * SPH_SDF_RESOLUTION);
+    for (int y = 0; y < SPH_SDF_RESOLUTION; y++)
+    {
+        for (int x = 0; x < SPH_SDF_RESOLUTION; x++)
+        {
+            // texel centers
+            glm::vec2 p(-1 + (x + 0.5f) * texel_size, -1 + (y + 0.5f) * texel_size);
+            // the walls of the domain box
+            float d = std::min(std::min(p.x - scene.domain_min.x, scene.domain_max.x - p.x), std::min(p.y - scene.domain_min.y, scene.domain_max.y - p.y));
+            for (const auto& o : scene.obstacles)
+            {
+                glm::vec2 local = p - o.center;
+                if (o.type == obstacle::shape::circle)
+                {
+                    d = std::min(d, std::sqrt(local.x * local.x + local.y * local.y) - o.size.x);
+                }
+                else
+                {
+                    float qx = std::abs(local.x) - o.size.x;
+                    float qy = std::abs(local.y) - o.size.y;
+                    float outside = std::sqrt(std::max(qx, 0.f) * std::max(qx, 0.f) + std::max(qy, 0.f) * std::max(qy, 0.f));
+                    d = std::min(d, outside + std::min(std::max(qx, qy), 0.f));
+                }
+            }
+            distance[y * SPH_SDF_RESOLUTION + x] = d;
+        }
+    }
+
+    // the gradient is the surface normal, stored next to the distance so the shaders need a single fetch
+    std::vector<glm::vec4> texels(distance.size());
+    for (int y = 0; y < SPH_SDF_RESOLUTION; y++)
+    {
+        for (int x = 0; x < SPH_SDF_RESOLUTION; x++)
+        {
+            auto sample = [&distance](int sx, int sy)
+            {
+                return distance[std::clamp(sy, 0, SPH_SDF_RESOLUTION - 1) * SPH_SDF_RESOLUTION + std::clamp(sx, 0, SPH_SDF_RESOLUTION - 1)];
+            };
+            float gx = sample(x + 1, y) - sample(x - 1, y);
+            float gy = sample(x, y + 1) - sample(x, y - 1);
+            float length = std::sqrt(gx * gx + gy * gy);
+            if (length > 0)
+            {
+                gx /= length;
+                gy /= length;
+            }
+            texels[y * SPH_SDF_RESOLUTION + x] = glm::vec4(sample(x, y), gx, gy, 0);
+        }
+    }
+
+    glGenTextures(1, &signed_distance_field_texture_handle);
+    glBindTexture(GL_TEXTURE_2D, signed_distance_field_texture_handle);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, SPH_SDF_RESOLUTION, SPH_SDF_RESOLUTION);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SPH_SDF_RESOLUTION, SPH_SDF_RESOLUTION, GL_RGBA, GL_FLOAT, texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    // sampled by compute_force.comp and integrate.comp
+    glBindTextureUnit(0, signed_distance_field_texture_handle);
+}
 
 void application::check_program_linked(GLuint shader_program_handle)
 {
@@ -352,35 +1163,283 @@ void application::check_program_linked(GLuint shader_program_handle)
         glGetProgramiv(shader_program_handle, GL_INFO_LOG_LENGTH, &len);
         std::vector<GLchar> log(len);
         glGetProgramInfoLog(shader_program_handle, len, &len, &log[0]);
-
-        for (const auto& el : log)
-        {
-            std::cout << el;
-        }
+        log_lines(log_level::error, log.data());
         throw std::runtime_error("shader link error");
     }
 
 }
 
-GLuint application::compile_shader(std::string path_to_file, GLenum shader_type)
+void application::set_parameters(const simulation_parameters& new_parameters)
 {
-    GLuint shader_handle = 0;
+    // zero or negative values turn the derived parameters into inf or nan
+    validate_parameters(new_parameters.time_step, new_parameters.particle_mass, new_parameters.rest_density,
+        new_parameters.domain_min, new_parameters.domain_max, dimensions());
+    const bool domain_changed = new_parameters.domain_min != current_parameters.domain_min || new_parameters.domain_max != current_parameters.domain_max;
+    current_parameters = new_parameters;
+    time_step = current_parameters.time_step;
+    derive_parameters(current_parameters);
+    glNamedBufferSubData(parameter_buffer_handle, 0, sizeof(simulation_parameters), &current_parameters);
 
-    std::ifstream shader_file(path_to_file, std::ios::ate | std::ios::binary);
-    if (!shader_file)
+    // the 2d walls are baked into the signed distance field
+    scene.domain_min = current_parameters.domain_min;
+    scene.domain_max = current_parameters.domain_max;
+    if (!three_dimensional && domain_changed && signed_distance_field_texture_handle != 0)
     {
-        throw std::runtime_error("shader file load error");
+        glDeleteTextures(1, &signed_distance_field_texture_handle);
+        create_signed_distance_field();
     }
-    size_t shader_file_size = (size_t)shader_file.tellg();
-    std::vector<char> shader_code(shader_file_size);
-    shader_file.seekg(0);
-    shader_file.read(shader_code.data(), shader_file_size);
-    shader_file.close();
+}
 
-    shader_handle = glCreateShader(shader_type);
+const simulation_parameters& application::parameters() const
+{
+    return current_parameters;
+}
+
+void application::set_member_parameters(uint32_t member, const simulation_parameters& new_parameters)
+{
+    if (member >= ensemble_parameters.size())
+    {
+        throw std::runtime_error("ensemble member out of range");
+    }
+    validate_parameters(new_parameters.time_step, new_parameters.particle_mass, new_parameters.rest_density,
+        new_parameters.domain_min, new_parameters.domain_max, dimensions());
+    // the walls of the signed distance field are shared, a member domain only clamps its particles
+    ensemble_parameters[member] = new_parameters;
+    derive_parameters(ensemble_parameters[member]);
+    glNamedBufferSubData(member_parameter_buffer_handle, sizeof(simulation_parameters) * member, sizeof(simulation_parameters), &ensemble_parameters[member]);
+}
+
+const simulation_parameters& application::member_parameters(uint32_t member) const
+{
+    return ensemble_parameters.at(member);
+}
+
+void application::step(uint32_t count)
+{
+    if (simulation_window != nullptr)
+    {
+        throw std::runtime_error("step needs an application that runs in lockstep");
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        run_simulation();
+        frame_number++;
+    }
+}
+
+void application::reset()
+{
+    // the particles of the scene as spawned by initialize_opengl, the derived parameters are still valid
+    const GLuint zero = 0;
+    glClearNamedBufferData(packed_particles_buffer_handle, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    if (sleep_buffer_handle != 0)
+    {
+        glClearNamedBufferData(sleep_buffer_handle, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    }
+    const simulation_state state = initial_state();
+    glNamedBufferSubData(simulation_state_buffer_handle, 0, sizeof(simulation_state), &state);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    update_indirect_commands();
+    spawn_fluid_blocks();
+    frame_number = 1;
+    simulated_seconds = 0;
+    next_snapshot_step = 0;
+    contour_step = 0;
+}
+
+void application::synchronize()
+{
+    glFinish();
+}
+
+uint64_t application::step_count() const
+{
+    return frame_number - 1;
+}
+
+double application::simulated_time() const
+{
+    return simulated_seconds;
+}
+
+uint32_t application::particle_count() const
+{
+    uint32_t count = 0;
+    glGetNamedBufferSubData(simulation_state_buffer_handle, offsetof(simulation_state, particle_count), sizeof(count), &count);
+    return count;
+}
+
+uint32_t application::capacity() const
+{
+    return particle_capacity;
+}
+
+uint32_t application::dimensions() const
+{
+    return three_dimensional ? 3 : 2;
+}
+
+void* application::mapped_particles() const
+{
+    return particle_mapping;
+}
+
+const std::vector<particle_attribute>& application::attributes() const
+{
+    return particle_attributes;
+}
+
+void application::export_particles(const std::string& path)
+{
+    // an exporter of its own, the one of -snapshot keeps its schedule
+    snapshot_exporter exporter;
+    exporter.start(path, particle_source(), true);
+    exporter.request(step_count(), simulated_time());
+    exporter.finish();
+}
+
+simulation_state application::initial_state() const
+{
+    simulation_state state {};
+    state.particle_count = scene.particle_count;
+    state.compacted_count = state.particle_count;
+    state.particle_capacity = particle_capacity;
+    return state;
+}
+
+// fills in the fields that follow from the others
+void application::derive_parameters(simulation_parameters& derived_parameters)
+{
+    float constraint_gradient = 0;
+    compute_prototype_parameters(derived_parameters.time_step, derived_parameters.particle_mass,
+        derived_parameters.pcisph_delta, derived_parameters.lattice_rest_density, constraint_gradient);
+    // relative to the constraint gradient of a full neighborhood, so it does not depend on the kernel scale
+    derived_parameters.pbf_relaxation = SPH_PBF_RELAXATION * constraint_gradient;
+}
+
+// pcisph scaling factor, rest density and the squared pbf constraint gradient, all taken from a particle with
+// a full neighborhood on the initial lattice
+void application::compute_prototype_parameters(float time_step, float mass, float& delta, float& rest_density, float& constraint_gradient)
+{
+    constexpr float h = SPH_SMOOTHING_LENGTH;
+    constexpr float pi = 3.1415927410125732421875f;
+    constexpr float spacing = 2 * SPH_PARTICLE_RADIUS;
+    const int extent = static_cast<int>(std::ceil(h / spacing));
+    // the 2d lattice is the z = 0 layer
+    const int extent_z = three_dimensional ? extent : 0;
+
+    rest_density = 0;
+    glm::vec3 gradient_sum(0, 0, 0);
+    float gradient_dot_sum = 0;
+    for (int z = -extent_z; z <= extent_z; z++)
+    {
+        for (int y = -extent; y <= extent; y++)
+        {
+            for (int x = -extent; x <= extent; x++)
+            {
+                glm::vec3 delta_position(x * spacing, y * spacing, z * spacing);
+                float r = std::sqrt(delta_position.x * delta_position.x + delta_position.y * delta_position.y + delta_position.z * delta_position.z);
+                if (r >= h)
+                {
+                    continue;
+                }
+                // same kernels as the shaders
+                rest_density += mass * 315.f * std::pow(h * h - r * r, 3.f) / (64.f * pi * std::pow(h, 9.f));
+                if (r > 0)
+                {
+                    float gradient_scale = -45.f / (pi * std::pow(h, 6.f)) * (h - r) * (h - r) / r;
+                    glm::vec3 gradient(gradient_scale * delta_position.x, gradient_scale * delta_position.y, gradient_scale * delta_position.z);
+                    gradient_sum.x += gradient.x;
+                    gradient_sum.y += gradient.y;
+                    gradient_sum.z += gradient.z;
+                    gradient_dot_sum += gradient.x * gradient.x + gradient.y * gradient.y + gradient.z * gradient.z;
+                }
+            }
+        }
+    }
+    const float gradient_sum_dot = gradient_sum.x * gradient_sum.x + gradient_sum.y * gradient_sum.y + gradient_sum.z * gradient_sum.z;
+    const float beta = 2 * (time_step * mass / rest_density) * (time_step * mass / rest_density);
+    const float denominator = beta * (gradient_sum_dot + gradient_dot_sum);
+    // the force kernel averages the pressures of both particles, which halves the acceleration of the textbook formulation
+    delta = denominator > 0 ? 2 / denominator : 0;
+    const float gradient_scale = mass / rest_density;
+    constraint_gradient = gradient_scale * gradient_scale * (gradient_sum_dot + gradient_dot_sum);
+}
+
+GLuint application::create_compute_program(std::string path_to_file, const std::vector<specialization_constant>& constants)
+{
+    GLuint compute_shader_handle = compile_shader(path_to_file, GL_COMPUTE_SHADER, constants);
+    GLuint program_handle = glCreateProgram();
+    glAttachShader(program_handle, compute_shader_handle);
+    glLinkProgram(program_handle);
+    check_program_linked(program_handle);
+    glDeleteShader(compute_shader_handle);
+    return program_handle;
+}
+
+GLuint application::create_graphics_program(const std::string& vertex_file, const std::string& fragment_file, const std::vector<specialization_constant>& constants)
+{
+    GLuint vertex_shader_handle = compile_shader(vertex_file, GL_VERTEX_SHADER, constants);
+    GLuint fragment_shader_handle = compile_shader(fragment_file, GL_FRAGMENT_SHADER, constants);
+    GLuint program_handle = glCreateProgram();
+    glAttachShader(program_handle, vertex_shader_handle);
+    glAttachShader(program_handle, fragment_shader_handle);
+    glLinkProgram(program_handle);
+    check_program_linked(program_handle);
+    glDeleteShader(vertex_shader_handle);
+    glDeleteShader(fragment_shader_handle);
+    return program_handle;
+}
+
+GLuint application::compile_shader(std::string path_to_file, GLenum shader_type, const std::vector<specialization_constant>& constants)
+{
+    GLuint shader_handle = 0;
+
+    path_to_file.insert(0, shader_directory);
+    // compile.py builds every shader a second time with SPH_3D defined
+    if (three_dimensional)
+    {
+        path_to_file.insert(path_to_file.rfind(".spv"), ".3d");
+    }
+    std::ifstream shader_file(path_to_file, std::ios::ate | std::ios::binary);
+    if (!shader_file)
+    {
+        throw std::runtime_error("shader file load error");
+    }
+    size_t shader_file_size = (size_t)shader_file.tellg();
+    std::vector<char> shader_code(shader_file_size);
+    shader_file.seekg(0);
+    shader_file.read(shader_code.data(), shader_file_size);
+    shader_file.close();
+
+    shader_handle = glCreateShader(shader_type);
 
     glShaderBinary(1, &shader_handle, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, shader_code.data(), static_cast<GLsizei>(shader_code.size()));
-    glSpecializeShader(shader_handle, "main", 0, nullptr, nullptr);
+    // specialization fails on ids the module does not declare, so the constants of a solver can be shared by
+    // every kernel. the ids come from the OpDecorate SpecId instructions after the 5 word header
+    std::vector<GLuint> declared_index;
+    const uint32_t* words = reinterpret_cast<const uint32_t*>(shader_code.data());
+    const size_t word_count = shader_code.size() / sizeof(uint32_t);
+    for (size_t word = 5; word < word_count && (words[word] >> 16) > 0; word += words[word] >> 16)
+    {
+        constexpr uint32_t op_decorate = 71;
+        constexpr uint32_t decoration_spec_id = 1;
+        if ((words[word] & 0xffff) == op_decorate && (words[word] >> 16) == 4 && word + 3 < word_count && words[word + 2] == decoration_spec_id)
+        {
+            declared_index.push_back(words[word + 3]);
+        }
+    }
+    std::vector<GLuint> constant_index;
+    std::vector<GLuint> constant_value;
+    for (const auto& constant : constants)
+    {
+        if (std::find(declared_index.begin(), declared_index.end(), constant.index) != declared_index.end())
+        {
+            constant_index.push_back(constant.index);
+            constant_value.push_back(constant.value);
+        }
+    }
+    glSpecializeShader(shader_handle, "main", static_cast<GLuint>(constant_index.size()), constant_index.data(), constant_value.data());
     int32_t is_compiled = 0;
     glGetShaderiv(shader_handle, GL_COMPILE_STATUS, &is_compiled);
     if (is_compiled == GL_FALSE)
@@ -389,10 +1448,7 @@ GLuint application::compile_shader(std::string path_to_file, GLenum shader_type)
         glGetShaderiv(shader_handle, GL_INFO_LOG_LENGTH, &len);
         std::vector<GLchar> log(len);
         glGetShaderInfoLog(shader_handle, len, &len, &log[0]);
-        for (const auto& el : log)
-        {
-            std::cout << el;
-        }
+        log_lines(log_level::error, log.data());
         throw std::runtime_error("shader compile error");
     }
     return shader_handle;
@@ -400,59 +1456,1014 @@ GLuint application::compile_shader(std::string path_to_file, GLenum shader_type)
 
 void application::main_loop()
 {
-    static std::chrono::high_resolution_clock::time_point frame_start;
-    static std::chrono::high_resolution_clock::time_point frame_end;
-    static int64_t total_frame_time_ns;
-
-    frame_start = std::chrono::high_resolution_clock::now();
+    // measure performance
+    stats.begin_frame();
+    tracer.resolve_gpu_spans();
+    SPH_TRACE_CPU_SCOPE(tracer, "frame");
 
     // process user inputs
-    glfwPollEvents();
+    {
+        SPH_TRACE_CPU_SCOPE(tracer, "glfwPollEvents");
+        glfwPollEvents();
+    }
+
+    // paced, the window is drawn at the present rate and not at all while it is minimized
+    const bool minimized = glfwGetWindowAttrib(window, GLFW_ICONIFIED) != 0;
+    if (pacer.enabled())
+    {
+        pacer.begin_frame(glfwGetWindowAttrib(window, GLFW_FOCUSED) != 0);
+        // the gpu times of the frame whose timer queries begin_frame of the stats just read
+        float milliseconds = 0;
+        uint32_t steps = 0;
+        if (stats.read_back(frame_stage::simulation, milliseconds, steps))
+        {
+            pacer.add_step_time(milliseconds, steps);
+        }
+        if (stats.read_back(frame_stage::render, milliseconds, steps))
+        {
+            pacer.add_render_time(milliseconds);
+        }
+    }
 
     // step through the simulation if not paused
     if (!paused)
     {
-        run_simulation();
-        frame_number++;
+        stats.begin_stage(frame_stage::simulation);
+        if (pacer.enabled())
+        {
+            // steps until the next one would delay the present
+            do
+            {
+                run_simulation();
+                frame_number++;
+                stats.add_step();
+                pacer.add_step();
+            } while (pacer.steps() < steps_per_frame || pacer.step_fits());
+        }
+        else
+        {
+            for (uint32_t step = 0; step < steps_per_frame; step++)
+            {
+                run_simulation();
+                frame_number++;
+                stats.add_step();
+            }
+        }
+        stats.end_stage(frame_stage::simulation);
+    }
+
+    if (pacer.enabled() && minimized)
+    {
+        // nobody to show the frame to
+        throttle_frames();
+        pacer.wait_for_present();
+    }
+    else
+    {
+        stats.begin_stage(frame_stage::render);
+        if (capture.active())
+        {
+            // drawn offscreen, the window gets a copy
+            glBindFramebuffer(GL_FRAMEBUFFER, capture.framebuffer());
+        }
+        render();
+        if (capture.active())
+        {
+            SPH_TRACE_SCOPE(tracer, "capture");
+            capture.read_frame();
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            if (!headless)
+            {
+                capture.blit(0);
+            }
+        }
+        stats.end_stage(frame_stage::render);
+        rendered_frames++;
+
+        if (!headless)
+        {
+            SPH_TRACE_CPU_SCOPE(tracer, "glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
+        if (capture.active())
+        {
+            capture.poll();
+        }
+        if (pacer.enabled())
+        {
+            throttle_frames();
+            pacer.wait_for_present();
+        }
+    }
+
+    if (stats.end_frame())
+    {
+        publish_stats();
+    }
+    if (metrics.running())
+    {
+        update_metrics();
+    }
+}
+
+// runs on the simulation thread with the simulation context current, see run
+void application::simulation_loop()
+{
+    glfwMakeContextCurrent(simulation_window);
+    try
+    {
+        while (simulation_running)
+        {
+            if (paused)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            stats.begin_frame();
+            tracer.resolve_gpu_spans();
+            {
+                SPH_TRACE_CPU_SCOPE(tracer, "step");
+                stats.begin_stage(frame_stage::simulation);
+                run_simulation();
+                stats.end_stage(frame_stage::simulation);
+                frame_number++;
+                hand_off_frame();
+            }
+            {
+                // the render thread reads the formatted summary when it publishes
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                stats.end_frame();
+            }
+            if (metrics.running())
+            {
+                update_metrics();
+            }
+        }
+    }
+    catch (...)
+    {
+        simulation_error = std::current_exception();
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
+    // queries are not shared between contexts, the ones of this thread go with it
+    glFinish();
+    tracer.resolve_gpu_spans();
+    tracer.destroy();
+    stats.destroy();
+    glfwMakeContextCurrent(nullptr);
+}
+
+// copies the positions and the draw command of the current step into a free slot and publishes it as the latest frame.
+// the copy is skipped while the previous frame has not been picked up, so the simulation pays for one copy per
+// presented frame. both sides only wait on fences on the gpu
+void application::hand_off_frame()
+{
+    {
+        std::lock_guard<std::mutex> lock(render_frame_mutex);
+        if (latest_frame_fresh)
+        {
+            return;
+        }
+    }
+    render_frame& frame = render_frames[written_frame];
+    if (frame.released != nullptr)
+    {
+        glWaitSync(frame.released, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(frame.released);
+        frame.released = nullptr;
+    }
+    const GLsizeiptr position_size = (three_dimensional ? sizeof(glm::vec4) : sizeof(glm::vec2)) * particle_capacity;
+    const GLintptr slot_offset = written_frame * render_frame_stride;
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    // the render passes over the particles dispatch indirectly like the simulation kernels
+    static_assert(offsetof(simulation_state, num_work_groups_x) == 0 && offsetof(simulation_state, draw_count) == 3 * sizeof(uint32_t));
+    glCopyNamedBufferSubData(simulation_state_buffer_handle, render_frame_buffer_handle, 0, slot_offset, 7 * sizeof(uint32_t));
+    glCopyNamedBufferSubData(packed_particles_buffer_handle, render_frame_buffer_handle, 0, slot_offset + SPH_RENDER_FRAME_HEADER, position_size);
+    if (render_frame_attribute_size != 0)
+    {
+        glCopyNamedBufferSubData(packed_particles_buffer_handle, render_frame_buffer_handle, render_frame_attribute_source, slot_offset + render_frame_attribute_offset, render_frame_attribute_size);
+    }
+    frame.ready = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // a fence can only be waited for from another context once it has been flushed
+    glFlush();
+    std::lock_guard<std::mutex> lock(render_frame_mutex);
+    std::swap(written_frame, latest_frame);
+    latest_frame_fresh = true;
+}
+
+// keeps the cpu at most one frame ahead of the gpu. the gpu always has the next frame queued, so it does not idle
+// between the steps and the render the way a wait for every step would make it
+void application::throttle_frames()
+{
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (frame_fence != nullptr)
+    {
+        glClientWaitSync(frame_fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(frame_fence);
+    }
+    frame_fence = fence;
+}
+
+// runs on the main thread with a simulation thread, handles events and draws the latest completed state
+void application::present_frame()
+{
+    // paced, the simulation thread has the gpu to itself between presents and while the window is minimized
+    if (pacer.enabled())
+    {
+        pacer.begin_frame(glfwGetWindowAttrib(window, GLFW_FOCUSED) != 0);
+        if (glfwGetWindowAttrib(window, GLFW_ICONIFIED) != 0)
+        {
+            glfwPollEvents();
+            pacer.wait_for_present();
+            return;
+        }
+    }
+
+    render_stats.begin_frame();
+    SPH_TRACE_CPU_SCOPE(tracer, "present");
+
+    {
+        SPH_TRACE_CPU_SCOPE(tracer, "glfwPollEvents");
+        glfwPollEvents();
     }
 
+    {
+        std::lock_guard<std::mutex> lock(render_frame_mutex);
+        if (latest_frame_fresh)
+        {
+            std::swap(presented_frame, latest_frame);
+            latest_frame_fresh = false;
+        }
+    }
+    render_frame& frame = render_frames[presented_frame];
+    if (frame.ready != nullptr)
+    {
+        glWaitSync(frame.ready, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(frame.ready);
+        frame.ready = nullptr;
+    }
+    const GLsizeiptr vector_size = three_dimensional ? sizeof(glm::vec4) : sizeof(glm::vec2);
+    const GLintptr slot_offset = presented_frame * render_frame_stride;
+    // the bindings of this context point at the slot, the shaders index it like the simulation buffers
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, render_frame_buffer_handle, slot_offset + SPH_RENDER_FRAME_HEADER, vector_size * particle_capacity);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, render_frame_buffer_handle);
+    if (render_frame_attribute_binding >= 0)
+    {
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, render_frame_attribute_binding, render_frame_buffer_handle, slot_offset + render_frame_attribute_offset, render_frame_attribute_size);
+    }
+
+    render_stats.begin_stage(frame_stage::render);
     render();
+    render_stats.end_stage(frame_stage::render);
+    // the slot may be drawn again next frame, only the last draw has to finish before the simulation reuses it.
+    // the swap flushes the fence
+    glDeleteSync(frame.released);
+    frame.released = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 
-    glfwSwapBuffers(window);
+    {
+        SPH_TRACE_CPU_SCOPE(tracer, "glfwSwapBuffers");
+        glfwSwapBuffers(window);
+    }
 
-    frame_end = std::chrono::high_resolution_clock::now();
+    rendered_frames++;
+    if (render_stats.end_frame())
+    {
+        publish_stats();
+    }
+    if (pacer.enabled())
+    {
+        pacer.wait_for_present();
+    }
+}
 
-    // measure performance
-    total_frame_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(frame_end - frame_start).count();
+// publishes a snapshot whenever a read back of the simulation state completes, about four times per second.
+// neither the gpu nor the exporter thread is ever waited for
+void application::update_metrics()
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (state_readback_fence == nullptr)
+    {
+        if (now >= next_state_readback)
+        {
+            glCopyNamedBufferSubData(simulation_state_buffer_handle, state_readback_buffer_handle, 0, 0, sizeof(simulation_state));
+            state_readback_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            next_state_readback = now + std::chrono::milliseconds(250);
+        }
+        return;
+    }
+    const GLenum wait_result = glClientWaitSync(state_readback_fence, 0, 0);
+    if (wait_result != GL_ALREADY_SIGNALED && wait_result != GL_CONDITION_SATISFIED)
+    {
+        return;
+    }
+    glDeleteSync(state_readback_fence);
+    state_readback_fence = nullptr;
+
+    metrics_snapshot snapshot;
+    snapshot.steps = frame_number - 1;
+    snapshot.simulated_seconds = simulated_seconds;
+    snapshot.wall_seconds = std::chrono::duration<double>(now - metrics_start).count();
+    snapshot.particle_count = state_readback->particle_count;
+    snapshot.particle_capacity = particle_capacity;
+    if (sleeping)
+    {
+        snapshot.active_cell_count = state_readback->awake_cell_count;
+    }
+    snapshot.particle_buffer_bytes = particle_buffer_bytes;
+    snapshot.frame_milliseconds = stats.frame_histogram().percentile(0.5f);
+    snapshot.gl_performance_messages = gl_performance_messages.load(std::memory_order_relaxed);
+    for (uint32_t stage = 0; stage < snapshot.gpu_milliseconds.size(); stage++)
+    {
+        snapshot.gpu_milliseconds[stage] = stats.gpu_histogram(static_cast<frame_stage>(stage)).percentile(0.5f);
+    }
+    metrics.publish(snapshot);
+}
+
+void application::write_trace()
+{
+    // with a simulation thread the gpu spans belong to its context, it resolves them every step
+    if (simulation_window == nullptr)
+    {
+        tracer.resolve_gpu_spans();
+    }
+    try
+    {
+        tracer.write(trace_path);
+        log_message(log_level::info, "trace written to %s", trace_path.c_str());
+    }
+    catch (const std::exception& e)
+    {
+        // also called on exit, where throwing would terminate
+        log_message(log_level::warning, "%s", e.what());
+    }
+}
+
+// with a simulation thread the frames of stats are steps and render_stats times the presentation. the text of the
+// simulation thread is copied under the mutex, the slow title and console updates happen after it is released
+void application::publish_stats()
+{
+    std::array<char, 256> summary {};
+    {
+        std::unique_lock<std::mutex> lock(stats_mutex, std::defer_lock);
+        if (simulation_window != nullptr)
+        {
+            lock.lock();
+        }
+        std::snprintf(summary.data(), summary.size(), "%s", stats.summary());
+        std::copy_n(stats.overlay_text(), overlay_characters.size(), overlay_characters.begin());
+    }
+    const char* frame_label = simulation_window == nullptr ? "frame" : "step";
+    const char* present_label = simulation_window == nullptr ? "" : " | present ";
+    const char* present_summary = simulation_window == nullptr ? "" : render_stats.summary();
+    switch (stats_target)
+    {
+    case stats_output::title:
+    {
+        // the ensemble size only shows when there is more than one simulation
+        char ensemble_text[32] = "";
+        if (ensemble_size > 1)
+        {
+            std::snprintf(ensemble_text, sizeof(ensemble_text), " | ensemble: %u", ensemble_size);
+        }
+        std::snprintf(title_text.data(), title_text.size(), "SPH Simulation (OpenGL) | solver: %s%s%s | particle capacity: %u | %s %llu | %s%s%s",
+            solver_name(), three_dimensional ? " 3d" : "", ensemble_text, particle_capacity, frame_label,
+            static_cast<unsigned long long>(frame_number), summary.data(), present_label, present_summary);
+        glfwSetWindowTitle(window, title_text.data());
+        break;
+    }
+    case stats_output::overlay:
+        if (simulation_window != nullptr)
+        {
+            // the last line is the draw time, which only the render thread measures
+            const uint32_t last_line = (SPH_STATS_OVERLAY_LINES - 1) * SPH_STATS_OVERLAY_COLUMNS;
+            std::copy_n(render_stats.overlay_text() + last_line, SPH_STATS_OVERLAY_COLUMNS, overlay_characters.begin() + last_line);
+        }
+        glNamedBufferSubData(overlay_buffer_handle, 4 * sizeof(uint32_t), sizeof(overlay_characters), overlay_characters.data());
+        break;
+    case stats_output::console:
+        log_message(log_level::info, "%s %llu | %s%s%s", frame_label, static_cast<unsigned long long>(frame_number), summary.data(), present_label, present_summary);
+        break;
+    default:
+        break;
+    }
+}
 
-    std::stringstream title;
-    title.precision(3);
-    title.setf(std::ios_base::fixed, std::ios_base::floatfield);
-    title << "SPH Simulation (OpenGL) | "
-        "particle count: " << SPH_NUM_PARTICLES << " | "
-        "frame " << frame_number << " | "
-        "frame time: " << 1e-6 * total_frame_time_ns << " ms | ";
-    glfwSetWindowTitle(window, title.str().c_str());
+const char* application::solver_name() const
+{
+    switch (solver)
+    {
+    case solver_type::pcisph:
+        return "pcisph";
+    case solver_type::pbf:
+        return "pbf";
+    default:
+        return "sph";
+    }
+}
+
+snapshot_source application::particle_source() const
+{
+    snapshot_source source {};
+    source.state_buffer = simulation_state_buffer_handle;
+    source.count_offset = offsetof(simulation_state, particle_count);
+    source.particle_buffer = packed_particles_buffer_handle;
+    source.position_offset = particle_attributes[0].offset * sizeof(uint32_t);
+    source.velocity_offset = particle_attributes[1].offset * sizeof(uint32_t);
+    source.density_offset = particle_attributes[3].offset * sizeof(uint32_t);
+    source.pressure_offset = particle_attributes[4].offset * sizeof(uint32_t);
+    source.particle_capacity = particle_capacity;
+    source.dimensions = three_dimensional ? 3 : 2;
+    return source;
+}
+
+// runs before the step, so a snapshot shows the state after frame_number - 1 steps
+void application::export_snapshot()
+{
+    SPH_TRACE_CPU_SCOPE(tracer, "snapshot");
+    snapshots.poll();
+    const uint64_t step = frame_number - 1;
+    if (step >= next_snapshot_step && snapshots.request(step, simulated_seconds))
+    {
+        // a delayed snapshot keeps the schedule, the next one is still due on the interval
+        next_snapshot_step = (step / snapshot_interval + 1) * snapshot_interval;
+    }
 }
 
 void application::run_simulation()
 {
-    glUseProgram(compute_program_handle[0]);
-    glDispatchCompute(SPH_NUM_WORK_GROUPS, 1, 1);
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-    glUseProgram(compute_program_handle[1]);
-    glDispatchCompute(SPH_NUM_WORK_GROUPS, 1, 1);
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-    glUseProgram(compute_program_handle[2]);
-    glDispatchCompute(SPH_NUM_WORK_GROUPS, 1, 1);
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    SPH_TRACE_SCOPE(tracer, "run_simulation");
+    if (snapshots.active())
+    {
+        export_snapshot();
+    }
+    // set_parameters may change the time step between steps, so the simulated time is summed step by step
+    simulated_seconds += time_step;
+    // work group counts come from the simulation state buffer, so the particle count can change without cpu involvement
+    if (solver == solver_type::pbf)
+    {
+        run_position_based_fluids();
+    }
+    else
+    {
+        build_grid();
+        // with sleeping cells the kernels only run over the particles listed by update_sleeping_cells
+        GLintptr kernel_dispatch = offsetof(simulation_state, num_work_groups_x);
+        if (sleeping)
+        {
+            update_sleeping_cells();
+            kernel_dispatch = offsetof(simulation_state, active_work_groups_x);
+        }
+        {
+            SPH_TRACE_SCOPE(tracer, "density_pressure");
+            stage_scope stage(stats, frame_stage::density);
+            glUseProgram(compute_program_handle[0]);
+            glDispatchComputeIndirect(kernel_dispatch);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        {
+            SPH_TRACE_SCOPE(tracer, "force");
+            stage_scope stage(stats, frame_stage::force);
+            glUseProgram(compute_program_handle[1]);
+            glDispatchComputeIndirect(kernel_dispatch);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        if (solver == solver_type::pcisph)
+        {
+            solve_pressure();
+        }
+        {
+            SPH_TRACE_SCOPE(tracer, "integrate");
+            stage_scope stage(stats, frame_stage::integrate);
+            glUseProgram(compute_program_handle[2]);
+            glDispatchComputeIndirect(kernel_dispatch);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+    }
+
+    if (scene.sinks.empty() && scene.emitters.empty())
+    {
+        return;
+    }
+    stage_scope stage(stats, frame_stage::particle_count);
+    if (!scene.sinks.empty())
+    {
+        compact_particles();
+    }
+    if (!scene.emitters.empty())
+    {
+        emit_particles();
+    }
+    update_indirect_commands();
+}
+
+// bins the particles into the uniform grid. afterwards the particles of cell c are
+// sorted_index[cell_start[c]] to sorted_index[cell_start[c + 1] - 1]
+void application::build_grid()
+{
+    SPH_TRACE_SCOPE(tracer, "build_grid");
+    stage_scope stage(stats, frame_stage::grid);
+    {
+        SPH_TRACE_SCOPE(tracer, "grid_clear");
+        const GLuint zero = 0;
+        glClearNamedBufferSubData(grid_buffer_handle, GL_R32UI, grid_scan_range.offset, grid_scan_range.size, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    {
+        SPH_TRACE_SCOPE(tracer, "grid_count");
+        glUseProgram(grid_count_program_handle);
+        glDispatchComputeIndirect(offsetof(simulation_state, num_work_groups_x));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    run_prefix_sum(grid_scan_range, grid_block_sum_range, num_grid_work_groups);
+    {
+        SPH_TRACE_SCOPE(tracer, "grid_sort");
+        glUseProgram(grid_sort_program_handle);
+        glDispatchComputeIndirect(offsetof(simulation_state, num_work_groups_x));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
+
+// flags the cells with moving particles, advances the rest counters of the cells and lists the particles of awake
+// cells and their neighbors. must run after build_grid, it reads the cell of every particle
+void application::update_sleeping_cells()
+{
+    SPH_TRACE_SCOPE(tracer, "update_sleeping_cells");
+    // sleep_cells only adds to the awake cell count, a reset in the same dispatch would race with the increments
+    const GLuint zero = 0;
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glClearNamedBufferSubData(simulation_state_buffer_handle, GL_R32UI, offsetof(simulation_state, awake_cell_count), sizeof(uint32_t),
+        GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    {
+        SPH_TRACE_SCOPE(tracer, "sleep_mark");
+        glUseProgram(sleep_mark_program_handle);
+        glDispatchComputeIndirect(offsetof(simulation_state, num_work_groups_x));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    {
+        SPH_TRACE_SCOPE(tracer, "sleep_cells");
+        glUseProgram(sleep_cells_program_handle);
+        glDispatchCompute(num_grid_work_groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    {
+        SPH_TRACE_SCOPE(tracer, "sleep_gather");
+        glUseProgram(sleep_gather_program_handle);
+        glDispatchComputeIndirect(offsetof(simulation_state, num_work_groups_x));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    }
+}
+
+// position based fluids. the density constraint is solved on the predicted positions with a fixed number of
+// jacobi iterations, so the neighborhood is found once per step
+void application::run_position_based_fluids()
+{
+    SPH_TRACE_SCOPE(tracer, "run_position_based_fluids");
+    {
+        SPH_TRACE_SCOPE(tracer, "pbf_predict");
+        glUseProgram(pbf_predict_program_handle);
+        glDispatchComputeIndirect(offsetof(simulation_state, num_work_groups_x));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    build_grid();
+    {
+        // the constraint iterations take the place of the pressure solve
+        stage_scope stage(stats, frame_stage::pressure);
+        for (int iteration = 0; iteration < SPH_PBF_ITERATIONS; iteration++)
+        {
+            {
+                SPH_TRACE_SCOPE(tracer, "pbf_lambda");
+                glUseProgram(pbf_lambda_program_handle);
+                glDispatchComputeIndirect(offsetof(simulation_state, num_work_groups_x));
+                glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            }
+            {
+                SPH_TRACE_SCOPE(tracer, "pbf_delta");
+                glUseProgram(pbf_delta_program_handle);
+                glDispatchComputeIndirect(offsetof(simulation_state, num_work_groups_x));
+                glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            }
+            {
+                SPH_TRACE_SCOPE(tracer, "pbf_apply");
+                glUseProgram(pbf_apply_program_handle);
+                glDispatchComputeIndirect(offsetof(simulation_state, num_work_groups_x));
+                glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            }
+        }
+    }
+    {
+        stage_scope stage(stats, frame_stage::integrate);
+        {
+            SPH_TRACE_SCOPE(tracer, "pbf_velocity");
+            glUseProgram(pbf_velocity_program_handle);
+            glDispatchComputeIndirect(offsetof(simulation_state, num_work_groups_x));
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        {
+            SPH_TRACE_SCOPE(tracer, "pbf_finalize");
+            glUseProgram(pbf_finalize_program_handle);
+            glDispatchComputeIndirect(offsetof(simulation_state, num_work_groups_x));
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+    }
+}
+
+// pcisph pressure iterations. every iteration is recorded, but once pcisph_check.comp sees the density error
+// within tolerance it zeroes the solver dispatch command and the remaining iterations run no work groups.
+void application::solve_pressure()
+{
+    SPH_TRACE_SCOPE(tracer, "solve_pressure");
+    stage_scope stage(stats, frame_stage::pressure);
+    // the density pass reset the solver dispatch command
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+    for (int iteration = 0; iteration < SPH_PCISPH_MAX_ITERATIONS; iteration++)
+    {
+        {
+            SPH_TRACE_SCOPE(tracer, "predict_position");
+            glUseProgram(predict_position_program_handle);
+            glDispatchComputeIndirect(offsetof(simulation_state, solver_work_groups_x));
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        {
+            SPH_TRACE_SCOPE(tracer, "predict_density");
+            glUseProgram(predict_density_program_handle);
+            glDispatchComputeIndirect(offsetof(simulation_state, solver_work_groups_x));
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        {
+            SPH_TRACE_SCOPE(tracer, "predict_force");
+            glUseProgram(predict_force_program_handle);
+            glDispatchComputeIndirect(offsetof(simulation_state, solver_work_groups_x));
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        {
+            SPH_TRACE_SCOPE(tracer, "pcisph_check");
+            glUseProgram(pcisph_check_program_handle);
+            glDispatchCompute(1, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+        }
+    }
+}
+
+// removes the particles inside sinks, the survivors keep their order
+void application::compact_particles()
+{
+    SPH_TRACE_SCOPE(tracer, "compact_particles");
+    {
+        SPH_TRACE_SCOPE(tracer, "mark_sinks");
+        glUseProgram(mark_sinks_program_handle);
+        glDispatchComputeIndirect(offsetof(simulation_state, num_work_groups_x));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    run_prefix_sum(compaction_scan_range, compaction_block_sum_range, 0);
+    // survivors are scattered into the scratch buffer and gathered back, both passes only touch live particles
+    {
+        SPH_TRACE_SCOPE(tracer, "compact_scatter");
+        glUseProgram(compact_scatter_program_handle);
+        glDispatchComputeIndirect(offsetof(simulation_state, num_work_groups_x));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    {
+        SPH_TRACE_SCOPE(tracer, "compact_gather");
+        glUseProgram(compact_gather_program_handle);
+        glDispatchComputeIndirect(offsetof(simulation_state, num_work_groups_x));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
+
+// exclusive prefix sum of the scan range, bound to binding 6 with its work group totals at binding 7.
+// zero work groups means one per particle work group, taken from the indirect dispatch command
+void application::run_prefix_sum(const buffer_range& scan, const buffer_range& block_sum, uint32_t num_work_groups)
+{
+    SPH_TRACE_SCOPE(tracer, "prefix_sum");
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 6, scan.buffer, scan.offset, scan.size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 7, block_sum.buffer, block_sum.offset, block_sum.size);
+    auto dispatch = [num_work_groups]()
+    {
+        if (num_work_groups == 0)
+        {
+            glDispatchComputeIndirect(offsetof(simulation_state, num_work_groups_x));
+        }
+        else
+        {
+            glDispatchCompute(num_work_groups, 1, 1);
+        }
+    };
+    {
+        SPH_TRACE_SCOPE(tracer, "scan_local");
+        glUseProgram(scan_local_program_handle);
+        dispatch();
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    {
+        SPH_TRACE_SCOPE(tracer, "scan_blocks");
+        glUseProgram(scan_blocks_program_handle);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    {
+        SPH_TRACE_SCOPE(tracer, "scan_add");
+        glUseProgram(scan_add_program_handle);
+        dispatch();
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
+
+// appends new particles behind the compacted ones, update_indirect.comp clamps the count to the capacity
+void application::emit_particles()
+{
+    {
+        SPH_TRACE_SCOPE(tracer, "emit");
+        glUseProgram(emit_program_handle);
+        glDispatchCompute(num_emit_work_groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
+
+// must run after every pass that changes the particle count in the simulation state buffer
+void application::update_indirect_commands()
+{
+    {
+        SPH_TRACE_SCOPE(tracer, "update_indirect");
+        glUseProgram(update_indirect_program_handle);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    }
 }
 
 void application::render()
 {
+    // the gpu spans of the recorder live in the simulation context when there is a simulation thread
+    trace_scope render_scope(tracer, "render", simulation_window == nullptr);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glUseProgram(render_program_handle);
-    glDrawArrays(GL_POINTS, 0, SPH_NUM_PARTICLES);
+    // the dispatch and draw commands come from the simulation state in lockstep, from the presented slot otherwise.
+    // both start with the dispatch command, the draw command follows at the offset of draw_count
+    const GLintptr frame_command = simulation_window == nullptr ? 0 : presented_frame * render_frame_stride;
+    if (view_changed)
+    {
+        glNamedBufferSubData(view_buffer_handle, 0, sizeof(view_parameters), &view);
+        view_changed = false;
+    }
+    if (style == render_style::density)
+    {
+        render_density(frame_command);
+    }
+    else
+    {
+        // points and splats are drawn from the list of particles in view
+        cull_particles(frame_command);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, cull_buffer_handle);
+        const GLintptr visible_draw_command = offsetof(cull_state, draw_count);
+        if (style == render_style::surface)
+        {
+            render_surface(visible_draw_command);
+        }
+        else
+        {
+            glUseProgram(render_program_handle);
+            glDrawArraysIndirect(GL_POINTS, reinterpret_cast<const void*>(visible_draw_command));
+        }
+    }
+    if (contour_resolution > 0)
+    {
+        if (contour_step == 0 || frame_number >= contour_step + contour_interval)
+        {
+            update_contour(frame_command);
+        }
+        glUseProgram(contour_program_handle);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, contour_buffer_handle);
+        glDrawArraysIndirect(GL_LINES, reinterpret_cast<const void*>(offsetof(contour_state, vertex_count)));
+    }
+    if (stats_target == stats_output::overlay)
+    {
+        glUseProgram(overlay_program_handle);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+}
+
+
+// screen-space fluid surface. the spheres are splatted at reduced resolution, so the cost of the overdraw and of the
+// smoothing is bounded by surface_scale instead of growing with the particle count on screen
+void application::initialize_surface()
+{
+    surface_width = std::max(static_cast<int>(framebuffer_width * surface_scale), 1);
+    surface_height = std::max(static_cast<int>(framebuffer_height * surface_scale), 1);
+    // the 3d view of particle.vert scales the box by 0.55
+    const float sphere_radius = SPH_SURFACE_SPHERE_RADIUS * SPH_PARTICLE_RADIUS * (three_dimensional ? 0.55f : 1.f);
+    // diameter in pixels, the target spans 2 units of normalized device coordinates
+    const float point_size = sphere_radius * surface_height;
+    std::vector<specialization_constant> splat_constants
+    {
+        { 3, 0 }, // THICKNESS_PASS
+        { 4, std::bit_cast<GLuint>(point_size) }, // POINT_SIZE
+        { 5, std::bit_cast<GLuint>(sphere_radius) }, // SPHERE_RADIUS
+        { 14, 1 }, // CULLED
+        { 7, ensemble_size }, // ENSEMBLE_SIZE
+        { 8, member_particle_count }, // MEMBER_PARTICLES
+    };
+    surface_depth_program_handle = create_graphics_program("particle.vert.spv", "surface_splat.frag.spv", splat_constants);
+    splat_constants[0].value = 1;
+    surface_thickness_program_handle = create_graphics_program("particle.vert.spv", "surface_splat.frag.spv", splat_constants);
+    for (uint32_t vertical = 0; vertical < 2; vertical++)
+    {
+        surface_filter_program_handle[vertical] = create_compute_program("surface_filter.comp.spv",
+            { { 2, surface_filter_radius }, { 3, vertical } }); // FILTER_RADIUS, VERTICAL
+    }
+    surface_composite_program_handle = create_graphics_program("surface_composite.vert.spv", "surface_composite.frag.spv");
+
+    // depth in r and thickness in g
+    glCreateTextures(GL_TEXTURE_2D, 2, surface_texture_handle);
+    for (GLuint texture : surface_texture_handle)
+    {
+        glTextureStorage2D(texture, 1, GL_RG32F, surface_width, surface_height);
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glCreateTextures(GL_TEXTURE_2D, 1, &surface_depth_texture_handle);
+    glTextureStorage2D(surface_depth_texture_handle, 1, GL_DEPTH_COMPONENT32F, surface_width, surface_height);
+    glCreateFramebuffers(1, &surface_framebuffer_handle);
+    glNamedFramebufferTexture(surface_framebuffer_handle, GL_COLOR_ATTACHMENT0, surface_texture_handle[0], 0);
+    glNamedFramebufferTexture(surface_framebuffer_handle, GL_DEPTH_ATTACHMENT, surface_depth_texture_handle, 0);
+    if (glCheckNamedFramebufferStatus(surface_framebuffer_handle, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::runtime_error("surface framebuffer is incomplete");
+    }
+    log_message(log_level::info, "surface rendering at %dx%d with a filter radius of %u", surface_width, surface_height, surface_filter_radius);
+}
+
+void application::render_surface(GLintptr draw_command)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, surface_framebuffer_handle);
+    glViewport(0, 0, surface_width, surface_height);
+    // nothing in front and no thickness
+    const GLfloat clear_surface[4] { 1, 0, 0, 0 };
+    const GLfloat clear_depth = 1;
+    glClearNamedFramebufferfv(surface_framebuffer_handle, GL_COLOR, 0, clear_surface);
+    glClearNamedFramebufferfv(surface_framebuffer_handle, GL_DEPTH, 0, &clear_depth);
+    {
+        SPH_TRACE_CPU_SCOPE(tracer, "surface_splat");
+        // the nearest sphere surface into r
+        glEnable(GL_DEPTH_TEST);
+        glColorMaski(0, GL_TRUE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glUseProgram(surface_depth_program_handle);
+        glDrawArraysIndirect(GL_POINTS, reinterpret_cast<const void*>(draw_command));
+        // the sum of the sphere thicknesses into g
+        glDisable(GL_DEPTH_TEST);
+        glColorMaski(0, GL_FALSE, GL_TRUE, GL_FALSE, GL_FALSE);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glUseProgram(surface_thickness_program_handle);
+        glDrawArraysIndirect(GL_POINTS, reinterpret_cast<const void*>(draw_command));
+        glDisable(GL_BLEND);
+        glColorMaski(0, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+    {
+        SPH_TRACE_CPU_SCOPE(tracer, "surface_filter");
+        // horizontal from the first texture into the second, vertical back into the first
+        const GLuint groups_x = (surface_width + 15) / 16;
+        const GLuint groups_y = (surface_height + 15) / 16;
+        for (uint32_t pass = 0; pass < 2; pass++)
+        {
+            glBindImageTexture(0, surface_texture_handle[pass], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+            glBindImageTexture(1, surface_texture_handle[1 - pass], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+            glUseProgram(surface_filter_program_handle[pass]);
+            glDispatchCompute(groups_x, groups_y, 1);
+            glMemoryBarrier(pass == 0 ? GL_SHADER_IMAGE_ACCESS_BARRIER_BIT : GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+    }
+    // composite at full resolution into the window or the capture target
+    glBindFramebuffer(GL_FRAMEBUFFER, capture.active() ? capture.framebuffer() : 0);
+    glViewport(0, 0, framebuffer_width, framebuffer_height);
+    glBindTextureUnit(1, surface_texture_handle[0]);
+    glUseProgram(surface_composite_program_handle);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+// boundary contour for analysis. the density of the drawn particles is splatted into a grid and marching squares turns
+// it into line segments, appended into a compact vertex list that is drawn indirectly. it runs on the render side
+// from the same positions as the draw, only every contour_interval steps, and costs a grid pass rather than a
+// neighbor search
+void application::initialize_contour()
+{
+    contour_splat_program_handle = create_compute_program("contour_splat.comp.spv",
+        { { 7, ensemble_size }, { 8, member_particle_count }, { 9, contour_resolution } }); // ENSEMBLE_SIZE, MEMBER_PARTICLES, CONTOUR_RESOLUTION
+    contour_extract_program_handle = create_compute_program("contour_extract.comp.spv", { { 9, contour_resolution } }); // CONTOUR_RESOLUTION
+    contour_program_handle = create_graphics_program("contour.vert.spv", "contour.frag.spv", { { 7, ensemble_size } }); // ENSEMBLE_SIZE
+
+    // a cell holds at most two segments
+    const GLsizeiptr cell_count = static_cast<GLsizeiptr>(contour_resolution - 1) * (contour_resolution - 1);
+    const GLsizeiptr vertex_size = sizeof(glm::vec2) * 4 * cell_count;
+    GLint ssbo_offset_alignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssbo_offset_alignment);
+    contour_vertex_offset = (sizeof(contour_state) + ssbo_offset_alignment - 1) / ssbo_offset_alignment * ssbo_offset_alignment;
+    glCreateBuffers(1, &contour_buffer_handle);
+    glNamedBufferStorage(contour_buffer_handle, contour_vertex_offset + vertex_size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    const GLuint zero = 0;
+    glClearNamedBufferData(contour_buffer_handle, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    const GLuint instance_count = 1;
+    glNamedBufferSubData(contour_buffer_handle, offsetof(contour_state, instance_count), sizeof(instance_count), &instance_count);
+    glCreateBuffers(1, &contour_grid_buffer_handle);
+    glNamedBufferStorage(contour_grid_buffer_handle, sizeof(uint32_t) * contour_resolution * contour_resolution, nullptr, 0);
+
+    // bindings of the render context, the simulation context has its own
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, parameter_buffer_handle);
+    if (ensemble_size > 1)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 22, member_parameter_buffer_handle);
+    }
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 24, contour_buffer_handle, 0, sizeof(contour_state));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 25, contour_grid_buffer_handle);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 26, contour_buffer_handle, contour_vertex_offset, vertex_size);
+    log_message(log_level::info, "contour on a %ux%u grid every %u steps", contour_resolution, contour_resolution, contour_interval);
+}
+
+void application::update_contour(GLintptr frame_command)
+{
+    SPH_TRACE_CPU_SCOPE(tracer, "contour");
+    contour_step = frame_number;
+    // the positions and the draw command of the frame being drawn
+    const GLuint frame_buffer = simulation_window == nullptr ? simulation_state_buffer_handle : render_frame_buffer_handle;
+    const GLuint position_buffer = simulation_window == nullptr ? packed_particles_buffer_handle : render_frame_buffer_handle;
+    const GLintptr position_offset = simulation_window == nullptr ? 0 : presented_frame * render_frame_stride + SPH_RENDER_FRAME_HEADER;
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 27, position_buffer, position_offset, sizeof(glm::vec2) * particle_capacity);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glCopyNamedBufferSubData(frame_buffer, contour_buffer_handle, frame_command + offsetof(simulation_state, draw_count), offsetof(contour_state, source_count), 4 * sizeof(uint32_t));
+    const GLuint zero = 0;
+    glClearNamedBufferSubData(contour_buffer_handle, GL_R32UI, offsetof(contour_state, vertex_count), sizeof(uint32_t), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glClearNamedBufferData(contour_grid_buffer_handle, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    glUseProgram(contour_splat_program_handle);
+    glDispatchComputeIndirect(frame_command);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    const GLuint groups = (contour_resolution - 1 + 15) / 16;
+    glUseProgram(contour_extract_program_handle);
+    glDispatchCompute(groups, groups, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+
+// aggregate renderer for large particle counts. the particles are accumulated into per pixel counts and speed sums
+// with image atomics and a full screen pass colors them, so nothing is rasterized per particle
+void application::initialize_density()
+{
+    density_splat_program_handle = create_compute_program("density_splat.comp.spv",
+        { { 7, ensemble_size }, { 8, member_particle_count } }); // ENSEMBLE_SIZE, MEMBER_PARTICLES
+    density_composite_program_handle = create_graphics_program("surface_composite.vert.spv", "density_composite.frag.spv");
+    glCreateTextures(GL_TEXTURE_2D, 2, density_texture_handle);
+    for (GLuint texture : density_texture_handle)
+    {
+        glTextureStorage2D(texture, 1, GL_R32UI, framebuffer_width, framebuffer_height);
+    }
+    glCreateBuffers(1, &density_buffer_handle);
+    glNamedBufferStorage(density_buffer_handle, 4 * sizeof(uint32_t), nullptr, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 29, density_buffer_handle);
+    glBindImageTexture(2, density_texture_handle[0], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+    glBindImageTexture(3, density_texture_handle[1], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+}
+
+void application::render_density(GLintptr frame_command)
+{
+    SPH_TRACE_CPU_SCOPE(tracer, "density");
+    // positions and velocities are at bindings 0 and 1, the draw command is copied
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glCopyNamedBufferSubData(simulation_window == nullptr ? simulation_state_buffer_handle : render_frame_buffer_handle, density_buffer_handle,
+        frame_command + offsetof(simulation_state, draw_count), 0, 4 * sizeof(uint32_t));
+    const GLuint zero = 0;
+    glClearTexImage(density_texture_handle[0], 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glClearTexImage(density_texture_handle[1], 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    glUseProgram(density_splat_program_handle);
+    glDispatchComputeIndirect(frame_command);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    glUseProgram(density_composite_program_handle);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+
+// lists the particles in view, so a zoomed in view only draws its part of a large simulation
+void application::cull_particles(GLintptr frame_command)
+{
+    SPH_TRACE_CPU_SCOPE(tracer, "cull");
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glCopyNamedBufferSubData(simulation_window == nullptr ? simulation_state_buffer_handle : render_frame_buffer_handle, cull_buffer_handle,
+        frame_command + offsetof(simulation_state, draw_count), offsetof(cull_state, source_count), 4 * sizeof(uint32_t));
+    const GLuint zero = 0;
+    glClearNamedBufferSubData(cull_buffer_handle, GL_R32UI, offsetof(cull_state, draw_count), sizeof(uint32_t), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glUseProgram(cull_program_handle);
+    glDispatchComputeIndirect(frame_command);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+glm::vec2 application::cursor_position() const
+{
+    double x = 0;
+    double y = 0;
+    int width = 1;
+    int height = 1;
+    glfwGetCursorPos(window, &x, &y);
+    glfwGetWindowSize(window, &width, &height);
+    return glm::vec2(static_cast<float>(2 * x / std::max(width, 1) - 1), static_cast<float>(1 - 2 * y / std::max(height, 1)));
 }
 
 } // namespace sph
@@ -0,0 +1,274 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "capture.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace sph
+{
+
+frame_capture::~frame_capture()
+{
+    finish();
+}
+
+void frame_capture::start(const std::string& path, uint32_t width, uint32_t height)
+{
+    this->width = width;
+    this->height = height;
+    const size_t percent = path.find('%');
+    if (percent != std::string::npos)
+    {
+        // only %d and %0Nd, the path is never used as a format string
+        size_t end = percent + 1;
+        while (end < path.size() && path[end] >= '0' && path[end] <= '9')
+        {
+            end++;
+        }
+        if (end >= path.size() || path[end] != 'd' || path.find('%', end) != std::string::npos)
+        {
+            throw std::runtime_error("capture path " + path + " needs a single %d or %0Nd for the frame number");
+        }
+        frame_digits = end > percent + 1 ? std::stoi(path.substr(percent + 1, end - percent - 1)) : 0;
+        path_prefix = path.substr(0, percent);
+        path_suffix = path.substr(end + 1);
+    }
+    else if (path.size() > 4 && (path.compare(path.size() - 4, 4, ".rgb") == 0 || path.compare(path.size() - 4, 4, ".raw") == 0))
+    {
+        stream.open(path, std::ios::binary | std::ios::trunc);
+        if (!stream)
+        {
+            throw std::runtime_error("cannot open capture stream " + path);
+        }
+    }
+    else
+    {
+        throw std::runtime_error("capture path " + path + " needs a %d frame number for images or a .rgb or .raw extension for a stream");
+    }
+
+    glCreateRenderbuffers(1, &color_renderbuffer_handle);
+    glNamedRenderbufferStorage(color_renderbuffer_handle, GL_RGBA8, width, height);
+    glCreateFramebuffers(1, &framebuffer_handle);
+    glNamedFramebufferRenderbuffer(framebuffer_handle, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_renderbuffer_handle);
+    if (glCheckNamedFramebufferStatus(framebuffer_handle, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::runtime_error("capture framebuffer is incomplete");
+    }
+
+    // rgba is the fast read path on most drivers, the encoders drop the alpha channel
+    const GLsizeiptr frame_size = GLsizeiptr(4) * width * height;
+    constexpr GLbitfield map_flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    for (slot& s : slots)
+    {
+        glCreateBuffers(1, &s.pixel_buffer);
+        glNamedBufferStorage(s.pixel_buffer, frame_size, nullptr, map_flags);
+        s.pixels = static_cast<const uint8_t*>(glMapNamedBufferRange(s.pixel_buffer, 0, frame_size, map_flags));
+    }
+
+    const uint32_t encoder_count = std::clamp(std::thread::hardware_concurrency() / 2, 1u, static_cast<uint32_t>(SPH_CAPTURE_MAX_ENCODERS));
+    stopping = false;
+    for (uint32_t i = 0; i < encoder_count; i++)
+    {
+        encoders.emplace_back(&frame_capture::run_encoder, this);
+    }
+    is_active = true;
+    log_message(log_level::info, "capturing %ux%u frames to %s with %u encoder threads", width, height, path.c_str(), encoder_count);
+}
+
+void frame_capture::finish()
+{
+    if (!is_active)
+    {
+        return;
+    }
+    glFinish();
+    poll();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_changed.notify_all();
+    for (auto& encoder : encoders)
+    {
+        encoder.join();
+    }
+    encoders.clear();
+    stream.close();
+    for (slot& s : slots)
+    {
+        glDeleteBuffers(1, &s.pixel_buffer);
+        s = slot {};
+    }
+    glDeleteFramebuffers(1, &framebuffer_handle);
+    glDeleteRenderbuffers(1, &color_renderbuffer_handle);
+    is_active = false;
+    log_message(log_level::info, "captured %llu frames", static_cast<unsigned long long>(next_frame));
+}
+
+bool frame_capture::active() const
+{
+    return is_active;
+}
+
+GLuint frame_capture::framebuffer() const
+{
+    return framebuffer_handle;
+}
+
+uint64_t frame_capture::frame_count() const
+{
+    return next_frame;
+}
+
+void frame_capture::read_frame()
+{
+    const uint32_t index = static_cast<uint32_t>(next_frame % SPH_CAPTURE_RING);
+    slot& s = slots[index];
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    if (s.busy)
+    {
+        // back pressure, the encoders are a full ring behind. the slot holds the oldest frame in flight, if its read
+        // has not been handed on yet it is the first in line
+        lock.unlock();
+        while (!reading.empty() && reading.front() == index)
+        {
+            glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            poll();
+        }
+        lock.lock();
+        slot_freed.wait(lock, [&s] { return !s.busy; });
+    }
+    s.busy = true;
+    lock.unlock();
+
+    s.frame = next_frame++;
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_handle);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pixel_buffer);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // without a buffer swap nothing else flushes the fence
+    glFlush();
+    reading.push_back(index);
+}
+
+void frame_capture::blit(GLuint target_framebuffer) const
+{
+    glBlitNamedFramebuffer(framebuffer_handle, target_framebuffer, 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
+
+void frame_capture::poll()
+{
+    // reads complete in order, so stop at the first one still in flight
+    while (!reading.empty())
+    {
+        slot& s = slots[reading.front()];
+        const GLenum wait_result = glClientWaitSync(s.fence, 0, 0);
+        if (wait_result != GL_ALREADY_SIGNALED && wait_result != GL_CONDITION_SATISFIED)
+        {
+            break;
+        }
+        glDeleteSync(s.fence);
+        s.fence = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            encode_queue.push_back(reading.front());
+        }
+        queue_changed.notify_one();
+        reading.pop_front();
+    }
+}
+
+void frame_capture::run_encoder()
+{
+    std::vector<uint8_t> rgb(size_t(3) * width * height);
+    while (true)
+    {
+        uint32_t index = 0;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_changed.wait(lock, [this] { return stopping || !encode_queue.empty(); });
+            if (encode_queue.empty())
+            {
+                return;
+            }
+            index = encode_queue.front();
+            encode_queue.pop_front();
+        }
+        encode(slots[index], rgb);
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            slots[index].busy = false;
+        }
+        slot_freed.notify_all();
+    }
+}
+
+void frame_capture::encode(slot& s, std::vector<uint8_t>& rgb)
+{
+    // OpenGL rows start at the bottom
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t* source = s.pixels + size_t(4) * width * (height - 1 - y);
+        uint8_t* destination = rgb.data() + size_t(3) * width * y;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            destination[3 * x] = source[4 * x];
+            destination[3 * x + 1] = source[4 * x + 1];
+            destination[3 * x + 2] = source[4 * x + 2];
+        }
+    }
+    if (stream.is_open())
+    {
+        // frames are taken from the queue in order, an encoder only waits for the ones before it
+        std::unique_lock<std::mutex> lock(stream_mutex);
+        stream_turn.wait(lock, [this, &s] { return next_stream_frame == s.frame; });
+        stream.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+        next_stream_frame++;
+        lock.unlock();
+        stream_turn.notify_all();
+        return;
+    }
+    const std::string path = frame_path(s.frame);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << "P6\n" << width << " " << height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+    if (!file)
+    {
+        log_message(log_level::warning, "cannot write %s", path.c_str());
+    }
+}
+
+std::string frame_capture::frame_path(uint64_t frame) const
+{
+    std::string number = std::to_string(frame);
+    if (number.size() < static_cast<size_t>(frame_digits))
+    {
+        number.insert(0, frame_digits - number.size(), '0');
+    }
+    return path_prefix + number + path_suffix;
+}
+
+} // namespace sph
@@ -0,0 +1,194 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "log.hpp"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace sph
+{
+
+namespace
+{
+
+const char* level_name(log_level level)
+{
+    switch (level)
+    {
+    case log_level::debug:
+        return "DEBUG";
+    case log_level::info:
+        return "INFO";
+    case log_level::warning:
+        return "WARNING";
+    default:
+        return "ERROR";
+    }
+}
+
+} // namespace
+
+void log_message(log_level level, const char* format, ...)
+{
+    logger& target = logger::instance();
+    if (!target.enabled(level))
+    {
+        return;
+    }
+    char text[SPH_LOG_MESSAGE_SIZE];
+    va_list arguments;
+    va_start(arguments, format);
+    std::vsnprintf(text, sizeof(text), format, arguments);
+    va_end(arguments);
+    target.push(level, text);
+}
+
+void log_lines(log_level level, const char* text)
+{
+    while (*text != '\0')
+    {
+        const char* end = std::strchr(text, '\n');
+        const int length = static_cast<int>(end != nullptr ? end - text : std::strlen(text));
+        if (length > 0)
+        {
+            log_message(level, "%.*s", length, text);
+        }
+        text += end != nullptr ? length + 1 : length;
+    }
+}
+
+logger& logger::instance()
+{
+    static logger shared;
+    return shared;
+}
+
+logger::logger()
+    : slots(std::make_unique<slot[]>(SPH_LOG_CAPACITY))
+{
+    for (uint64_t i = 0; i < SPH_LOG_CAPACITY; i++)
+    {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    writer_thread = std::thread(&logger::run, this);
+}
+
+logger::~logger()
+{
+    stopping = true;
+    writer_thread.join();
+}
+
+void logger::set_level(log_level level)
+{
+    minimum_level.store(level, std::memory_order_relaxed);
+}
+
+bool logger::enabled(log_level level) const
+{
+    return level >= minimum_level.load(std::memory_order_relaxed);
+}
+
+uint64_t logger::dropped_count() const
+{
+    return drops.load(std::memory_order_relaxed);
+}
+
+// bounded queue after Vyukov, a producer claims a position with a compare exchange and publishes the slot through its
+// sequence number. a full queue drops the message instead of waiting for the writer
+void logger::push(log_level level, const char* text)
+{
+    uint64_t position = enqueue_position.load(std::memory_order_relaxed);
+    slot* s = nullptr;
+    while (true)
+    {
+        s = &slots[position % SPH_LOG_CAPACITY];
+        const int64_t difference = static_cast<int64_t>(s->sequence.load(std::memory_order_acquire) - position);
+        if (difference == 0)
+        {
+            if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (difference < 0)
+        {
+            drops.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            position = enqueue_position.load(std::memory_order_relaxed);
+        }
+    }
+    s->level = level;
+    std::snprintf(s->text, sizeof(s->text), "%s", text);
+    s->sequence.store(position + 1, std::memory_order_release);
+}
+
+bool logger::write_next()
+{
+    slot& s = slots[dequeue_position % SPH_LOG_CAPACITY];
+    if (s.sequence.load(std::memory_order_acquire) != dequeue_position + 1)
+    {
+        return false;
+    }
+    std::cout << "[" << level_name(s.level) << "] " << s.text << '\n';
+    // hands the slot back to the producers for the next lap of the ring
+    s.sequence.store(dequeue_position + SPH_LOG_CAPACITY, std::memory_order_release);
+    dequeue_position++;
+    return true;
+}
+
+void logger::run()
+{
+    while (true)
+    {
+        // read before draining, so a message pushed ahead of the stop request is still written
+        const bool stop = stopping.load();
+        bool wrote = false;
+        while (write_next())
+        {
+            wrote = true;
+        }
+        const uint64_t dropped = drops.load(std::memory_order_relaxed);
+        if (dropped != reported_drops)
+        {
+            std::cout << "[WARNING] " << dropped - reported_drops << " log messages dropped, the queue was full" << '\n';
+            reported_drops = dropped;
+            wrote = true;
+        }
+        if (wrote)
+        {
+            std::cout.flush();
+        }
+        if (stop)
+        {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+}
+
+} // namespace sph
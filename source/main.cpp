@@ -19,11 +19,30 @@
 // SOFTWARE.
 
 #include "application.hpp"
+#include "log.hpp"
 #include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
 
+// the window client of libsph, the command line flags are documented in options.cpp
 int main(int argc, char** argv)
 {
-    // use alternate scene if "-a" is specified in the command line argument
-    sph::application app((std::find(argv, argv + argc, std::string("-a")) != argv + argc) ? 1 : 0);
-    app.run();
+    try
+    {
+        const sph::application_options options = sph::parse_options(argc, argv);
+        // "-verbose" also prints debug messages, among them the OpenGL performance warnings
+        if (std::find(argv, argv + argc, std::string("-verbose")) != argv + argc)
+        {
+            sph::logger::instance().set_level(sph::log_level::debug);
+        }
+        sph::application app(options);
+        app.run();
+    }
+    catch (const std::exception& e)
+    {
+        // returning lets the logger write out what is still queued
+        sph::log_message(sph::log_level::error, "%s", e.what());
+        return EXIT_FAILURE;
+    }
 }
@@ -0,0 +1,269 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "metrics.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace sph
+{
+
+namespace
+{
+
+#ifdef _WIN32
+using socket_type = SOCKET;
+void close_socket(socket_type s)
+{
+    closesocket(s);
+}
+// windows sockets do not raise signals
+constexpr int MSG_NOSIGNAL = 0;
+void set_timeout(socket_type s, int milliseconds)
+{
+    const DWORD timeout = milliseconds;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+}
+#else
+using socket_type = int;
+constexpr socket_type INVALID_SOCKET = -1;
+void close_socket(socket_type s)
+{
+    close(s);
+}
+void set_timeout(socket_type s, int milliseconds)
+{
+    const timeval timeout { milliseconds / 1000, (milliseconds % 1000) * 1000 };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+#endif
+
+constexpr uintptr_t no_socket = ~uintptr_t(0);
+
+} // namespace
+
+metrics_exporter::~metrics_exporter()
+{
+    stop();
+}
+
+void metrics_exporter::start(const std::string& file_path, uint16_t port, float interval_seconds)
+{
+    this->file_path = file_path;
+    this->interval_seconds = interval_seconds;
+    if (port != 0)
+    {
+#ifdef _WIN32
+        WSADATA wsa_data;
+        if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
+        {
+            throw std::runtime_error("winsock initialization failed");
+        }
+#endif
+        socket_type s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (s == INVALID_SOCKET)
+        {
+            throw std::runtime_error("metrics socket creation failed");
+        }
+        int reuse = 1;
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+        // local only, a scraper on another machine goes through a proxy
+        sockaddr_in address {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(s, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(s, 4) != 0)
+        {
+            close_socket(s);
+            throw std::runtime_error("metrics port " + std::to_string(port) + " cannot be bound");
+        }
+        listen_socket = static_cast<uintptr_t>(s);
+    }
+    stopping = false;
+    exporter_thread = std::thread([this]() { run(); });
+}
+
+void metrics_exporter::stop()
+{
+    if (!exporter_thread.joinable())
+    {
+        return;
+    }
+    stopping = true;
+    exporter_thread.join();
+    if (listen_socket != no_socket)
+    {
+        close_socket(static_cast<socket_type>(listen_socket));
+        listen_socket = no_socket;
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+}
+
+bool metrics_exporter::running() const
+{
+    return exporter_thread.joinable();
+}
+
+void metrics_exporter::publish(const metrics_snapshot& snapshot)
+{
+    std::unique_lock lock(snapshot_mutex, std::try_to_lock);
+    if (lock.owns_lock())
+    {
+        latest = snapshot;
+    }
+}
+
+void metrics_exporter::run()
+{
+    using clock = std::chrono::steady_clock;
+    const auto interval = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(interval_seconds));
+    clock::time_point next_update = clock::now();
+    while (!stopping)
+    {
+        metrics_snapshot snapshot;
+        {
+            std::lock_guard lock(snapshot_mutex);
+            snapshot = latest;
+        }
+        const clock::time_point now = clock::now();
+        if (now >= next_update)
+        {
+            next_update = now + interval;
+            if (snapshot.wall_seconds > previous_wall_seconds)
+            {
+                steps_per_second = (snapshot.steps - previous_steps) / (snapshot.wall_seconds - previous_wall_seconds);
+                previous_steps = snapshot.steps;
+                previous_wall_seconds = snapshot.wall_seconds;
+            }
+            if (!file_path.empty())
+            {
+                write_file(format(snapshot));
+            }
+        }
+        if (listen_socket != no_socket)
+        {
+            serve(snapshot);
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::min(std::chrono::duration_cast<clock::duration>(std::chrono::milliseconds(100)), next_update - clock::now()));
+        }
+    }
+}
+
+// answers at most one request, waits up to 100 ms for it so stop is noticed quickly
+void metrics_exporter::serve(const metrics_snapshot& snapshot)
+{
+    const socket_type s = static_cast<socket_type>(listen_socket);
+    fd_set read_set;
+    FD_ZERO(&read_set);
+    FD_SET(s, &read_set);
+    timeval timeout { 0, 100000 };
+    if (select(static_cast<int>(s) + 1, &read_set, nullptr, nullptr, &timeout) <= 0)
+    {
+        return;
+    }
+    socket_type client = accept(s, nullptr, nullptr);
+    if (client == INVALID_SOCKET)
+    {
+        return;
+    }
+    // a silent or stalled client must not block the thread, stop joins it
+    set_timeout(client, 1000);
+    // every request gets the metrics, the request line is not parsed
+    char request[1024];
+    recv(client, request, sizeof(request), 0);
+    const std::string body = format(snapshot);
+    const std::string response = "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "Connection: close\r\n\r\n" + body;
+    // a client that already hung up must not raise sigpipe
+    send(client, response.data(), static_cast<int>(response.size()), MSG_NOSIGNAL);
+    close_socket(client);
+}
+
+std::string metrics_exporter::format(const metrics_snapshot& snapshot)
+{
+    std::string text;
+    char line[256];
+    auto metric = [&text, &line](const char* name, const char* type, const char* help, double value)
+    {
+        std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n%s %.9g\n", name, help, name, type, name, value);
+        text += line;
+    };
+    metric("sph_steps_total", "counter", "Simulation steps since start.", static_cast<double>(snapshot.steps));
+    metric("sph_simulated_seconds_total", "counter", "Simulated time.", snapshot.simulated_seconds);
+    metric("sph_steps_per_second", "gauge", "Simulation steps per wall clock second.", steps_per_second);
+    metric("sph_frame_milliseconds", "gauge", "Median cpu frame time.", snapshot.frame_milliseconds);
+    metric("sph_particles", "gauge", "Live particles.", snapshot.particle_count);
+    metric("sph_particle_capacity", "gauge", "Particle capacity of the buffers.", snapshot.particle_capacity);
+    if (snapshot.active_cell_count)
+    {
+        metric("sph_active_cells", "gauge", "Grid cells the kernels run over.", *snapshot.active_cell_count);
+    }
+    metric("sph_gl_performance_messages_total", "counter", "Performance warnings of the OpenGL debug output.", static_cast<double>(snapshot.gl_performance_messages));
+    metric("sph_particle_buffer_bytes", "gauge", "Memory of the particle, grid and solver buffers.", static_cast<double>(snapshot.particle_buffer_bytes));
+    text += "# HELP sph_gpu_pass_milliseconds Median gpu time of a pass.\n# TYPE sph_gpu_pass_milliseconds gauge\n";
+    for (uint32_t stage = 0; stage < snapshot.gpu_milliseconds.size(); stage++)
+    {
+        std::snprintf(line, sizeof(line), "sph_gpu_pass_milliseconds{pass=\"%s\"} %.9g\n", stage_name(static_cast<frame_stage>(stage)), snapshot.gpu_milliseconds[stage]);
+        text += line;
+    }
+    return text;
+}
+
+void metrics_exporter::write_file(const std::string& text) const
+{
+    const std::string temporary_path = file_path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        file << text;
+        if (!file)
+        {
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary_path, file_path, error);
+}
+
+} // namespace sph
@@ -0,0 +1,219 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "application.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace sph
+{
+
+application_options parse_options(int argc, char** argv)
+{
+    auto has_argument = [argc, argv](const std::string& argument)
+    {
+        return std::find(argv, argv + argc, argument) != argv + argc;
+    };
+    auto argument_value = [argc, argv](const std::string& argument) -> std::string
+    {
+        auto it = std::find(argv, argv + argc, argument);
+        return it != argv + argc && it + 1 != argv + argc ? *(it + 1) : "";
+    };
+    application_options options;
+    // load a scene file with "-scene <path>", the flags below pick a built-in scene otherwise
+    options.scene_path = argument_value("-scene");
+    // use alternate scene if "-a" is specified in the command line argument, inflow/outflow channel with "-c"
+    if (has_argument("-a"))
+    {
+        options.scene_id = 1;
+    }
+    else if (has_argument("-c"))
+    {
+        options.scene_id = 2;
+    }
+    // predictive-corrective incompressible sph with "-pcisph", position based fluids with "-pbf", the scene decides otherwise
+    if (has_argument("-pcisph"))
+    {
+        options.solver = solver_type::pcisph;
+    }
+    else if (has_argument("-pbf"))
+    {
+        options.solver = solver_type::pbf;
+    }
+    // skip the particles of settled cells with "-sleep", sph solver only
+    options.sleeping = has_argument("-sleep");
+    // built-in 3d scenes with "-3d", the channel scene is 2d only
+    options.three_dimensional = has_argument("-3d");
+    // run independent copies of the scene side by side with "-ensemble <count>",
+    // "-sweep <parameter> <first> <last>" spreads one parameter over them
+    if (!argument_value("-ensemble").empty())
+    {
+        options.ensemble_size = static_cast<uint32_t>(std::stoul(argument_value("-ensemble")));
+    }
+    auto sweep = std::find(argv, argv + argc, std::string("-sweep"));
+    if (sweep != argv + argc)
+    {
+        if (argv + argc - sweep < 4)
+        {
+            throw std::runtime_error("usage: -sweep <parameter> <first> <last>");
+        }
+        options.sweep = parameter_sweep{ sweep[1], std::stof(sweep[2]), std::stof(sweep[3]) };
+    }
+    // frame statistics go to the window title by default, "-stats overlay|console|none" moves them,
+    // "-stats_interval <seconds>" sets how often they are refreshed
+    const std::string stats = argument_value("-stats");
+    if (stats == "overlay")
+    {
+        options.stats = stats_output::overlay;
+    }
+    else if (stats == "console")
+    {
+        options.stats = stats_output::console;
+    }
+    else if (stats == "none")
+    {
+        options.stats = stats_output::none;
+    }
+    else if (!stats.empty() && stats != "title")
+    {
+        throw std::runtime_error("usage: -stats title|overlay|console|none");
+    }
+    if (!argument_value("-stats_interval").empty())
+    {
+        options.stats_interval = std::stof(argument_value("-stats_interval"));
+    }
+    // record a timeline of the cpu and gpu work with "-trace <path>", open it in chrome://tracing or ui.perfetto.dev
+    options.trace_path = argument_value("-trace");
+    // prometheus metrics with "-metrics_file <path>" (textfile collector) and/or "-metrics_port <port>" (http on 127.0.0.1)
+    options.metrics_path = argument_value("-metrics_file");
+    if (!argument_value("-metrics_port").empty())
+    {
+        options.metrics_port = static_cast<uint16_t>(std::stoul(argument_value("-metrics_port")));
+    }
+    // simulate, render and swap on one thread with "-lockstep", the simulation has a thread of its own otherwise
+    options.simulation_thread = !has_argument("-lockstep");
+    // record the frames with "-capture <path>", a %05d in the path writes numbered ppm images and a .rgb or .raw path
+    // a raw rgb24 stream. "-steps_per_frame <n>" spaces the frames, "-frames <n>" stops after n frames and "-headless"
+    // hides the window
+    options.capture_path = argument_value("-capture");
+    if (!argument_value("-steps_per_frame").empty())
+    {
+        options.steps_per_frame = static_cast<uint32_t>(std::stoul(argument_value("-steps_per_frame")));
+    }
+    if (!argument_value("-frames").empty())
+    {
+        options.frame_limit = std::stoull(argument_value("-frames"));
+    }
+    options.headless = has_argument("-headless");
+    // write the particles with "-snapshot <path>" every "-snapshot_interval <steps>" steps, the extension (.vtk, .csv,
+    // .bin) picks the format. "-snapshot_delay" takes a snapshot the writers cannot keep up with later instead of
+    // dropping it
+    options.snapshot_path = argument_value("-snapshot");
+    if (!argument_value("-snapshot_interval").empty())
+    {
+        options.snapshot_interval = static_cast<uint32_t>(std::stoul(argument_value("-snapshot_interval")));
+    }
+    options.snapshot_delay = has_argument("-snapshot_delay");
+    // "-render surface" draws a smoothed fluid surface instead of points, "-render density" colors every pixel by the
+    // number and the speed of its particles. "-surface_scale <fraction>" sets the resolution of the surface splats
+    // relative to the window, "-surface_filter <pixels>" the radius of the smoothing
+    const std::string render = argument_value("-render");
+    if (render == "surface")
+    {
+        options.style = render_style::surface;
+    }
+    else if (render == "density")
+    {
+        options.style = render_style::density;
+    }
+    else if (!render.empty() && render != "points")
+    {
+        throw std::runtime_error("usage: -render points|surface|density");
+    }
+    if (!argument_value("-surface_scale").empty())
+    {
+        options.surface_scale = std::stof(argument_value("-surface_scale"));
+    }
+    if (!argument_value("-surface_filter").empty())
+    {
+        options.surface_filter_radius = static_cast<uint32_t>(std::stoul(argument_value("-surface_filter")));
+    }
+    // "-color speed|density|pressure" colors the points by a particle attribute, "-colormap viridis|diverging|gray"
+    // picks the colors and "-color_range <min> <max>" the values at their ends
+    const std::string color = argument_value("-color");
+    if (color == "speed")
+    {
+        options.coloring = color_attribute::speed;
+    }
+    else if (color == "density")
+    {
+        options.coloring = color_attribute::density;
+    }
+    else if (color == "pressure")
+    {
+        options.coloring = color_attribute::pressure;
+    }
+    else if (!color.empty())
+    {
+        throw std::runtime_error("usage: -color speed|density|pressure");
+    }
+    const std::string colormap = argument_value("-colormap");
+    if (colormap == "diverging")
+    {
+        options.colormap = color_map::diverging;
+    }
+    else if (colormap == "gray")
+    {
+        options.colormap = color_map::grayscale;
+    }
+    else if (!colormap.empty() && colormap != "viridis")
+    {
+        throw std::runtime_error("usage: -colormap viridis|diverging|gray");
+    }
+    auto color_range = std::find(argv, argv + argc, std::string("-color_range"));
+    if (color_range != argv + argc)
+    {
+        if (argv + argc - color_range < 3)
+        {
+            throw std::runtime_error("usage: -color_range <min> <max>");
+        }
+        options.color_min = std::stof(*(color_range + 1));
+        options.color_max = std::stof(*(color_range + 2));
+    }
+    // "-present_rate <hz>" sets the frames per second shown, 0 draws as often as possible
+    if (!argument_value("-present_rate").empty())
+    {
+        options.present_rate = std::stof(argument_value("-present_rate"));
+    }
+    // "-contour [nodes]" traces the boundary of the fluid (2d), "-contour_interval <steps>" sets how often
+    if (has_argument("-contour"))
+    {
+        const std::string contour = argument_value("-contour");
+        options.contour_resolution = contour.empty() || contour[0] == '-' ? SPH_CONTOUR_RESOLUTION : static_cast<uint32_t>(std::stoul(contour));
+    }
+    if (!argument_value("-contour_interval").empty())
+    {
+        options.contour_interval = static_cast<uint32_t>(std::stoul(argument_value("-contour_interval")));
+    }
+    return options;
+}
+
+} // namespace sph
@@ -0,0 +1,92 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "pacing.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace sph
+{
+
+void frame_pacer::initialize(float present_rate)
+{
+    interval = present_rate > 0 ? std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / present_rate)) : clock::duration::zero();
+    background_interval = std::max(interval, std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / SPH_BACKGROUND_PRESENT_RATE)));
+    present_deadline = clock::now();
+}
+
+bool frame_pacer::enabled() const
+{
+    return interval > clock::duration::zero();
+}
+
+void frame_pacer::begin_frame(bool focused)
+{
+    const clock::time_point now = clock::now();
+    const clock::duration frame_interval = focused ? interval : background_interval;
+    present_deadline += frame_interval;
+    if (present_deadline < now)
+    {
+        present_deadline = now + frame_interval;
+    }
+    frame_budget = std::chrono::duration<double>(frame_interval).count();
+    frame_steps = 0;
+}
+
+bool frame_pacer::step_fits() const
+{
+    // the cpu only queues the steps, so the clock cannot tell how far the gpu is. until the first step time is read
+    // back only the minimum steps run
+    return step_cost > 0 && (frame_steps + 1) * step_cost + render_cost < frame_budget;
+}
+
+void frame_pacer::add_step()
+{
+    frame_steps++;
+}
+
+void frame_pacer::add_step_time(float milliseconds, uint32_t steps)
+{
+    if (steps == 0)
+    {
+        return;
+    }
+    const double seconds = 1e-3 * milliseconds / steps;
+    step_cost = step_cost == 0 ? seconds : step_cost + SPH_PACING_SMOOTHING * (seconds - step_cost);
+}
+
+void frame_pacer::add_render_time(float milliseconds)
+{
+    const double seconds = 1e-3 * milliseconds;
+    render_cost = render_cost == 0 ? seconds : render_cost + SPH_PACING_SMOOTHING * (seconds - render_cost);
+}
+
+void frame_pacer::wait_for_present() const
+{
+    std::this_thread::sleep_until(present_deadline);
+}
+
+uint32_t frame_pacer::steps() const
+{
+    return frame_steps;
+}
+
+} // namespace sph
@@ -0,0 +1,391 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "scene.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+
+namespace sph
+{
+
+namespace
+{
+
+const char* const default_scene_text[] =
+{
+    // test case 1
+    "dimensions 2\n"
+    "block -0.625 -0.59 125 160\n",
+    // test case 2
+    "dimensions 2\n"
+    "block -1 -1 100 200\n",
+    // test case 3, inflow/outflow channel
+    "dimensions 2\n"
+    "# the population settles where inflow matches outflow, this is the headroom for it\n"
+    "capacity 30000\n"
+    "block -1 -1 200 40\n"
+    "# a row of 20 particles every 2 steps keeps the rows 2 particle radii apart at this speed and a time step of 0.0001\n"
+    "emitter -0.95 0.5 50 0 20 2\n"
+    "sink 0.9 -1 1 -0.5\n"
+    "circle -0.3 0.1 0.15\n"
+    "box 0.4 -0.85 0.05 0.15\n",
+};
+
+const char* const default_scene_3d_text[] =
+{
+    // test case 1, a column of fluid dropped into the corner of the box
+    "dimensions 3\n"
+    "block -0.995 -0.5 -0.995 60 100 60\n",
+    // test case 2, a dam break of a million particles released from one octant of the box
+    "dimensions 3\n"
+    "block -0.995 -0.995 -0.995 100 100 100\n",
+};
+
+} // namespace
+
+void validate_parameters(std::optional<float> time_step, std::optional<float> particle_mass, float rest_density,
+    const glm::vec4& domain_min, const glm::vec4& domain_max, uint32_t dimensions)
+{
+    // written so that nan fails every check
+    if (time_step && !(*time_step > 0))
+    {
+        throw std::runtime_error("time_step must be positive");
+    }
+    if (particle_mass && !(*particle_mass > 0))
+    {
+        throw std::runtime_error("mass must be positive");
+    }
+    if (!(rest_density > 0))
+    {
+        throw std::runtime_error("rest_density must be positive");
+    }
+    for (uint32_t component = 0; component < dimensions; component++)
+    {
+        if (!(domain_min[component] >= -1 && domain_max[component] <= 1 && domain_min[component] < domain_max[component]))
+        {
+            throw std::runtime_error("domain must be a non-empty box within [-1, 1]");
+        }
+    }
+}
+
+// line based, one keyword and its values per line, '#' starts a comment. vectors have as many components as the
+// scene has dimensions, so "dimensions" must come before them.
+//
+//   dimensions 2|3
+//   solver sph|pcisph|pbf
+//   time_step <seconds>
+//   gravity <vector>
+//   stiffness <value>
+//   viscosity <value>
+//   rest_density <value>
+//   mass <value>
+//   domain <min corner> <max corner>
+//   capacity <particles>
+//   block <min corner> <particles per axis>
+//   emitter <position> <velocity> <particles per row> <interval in steps>    2d only
+//   sink <min corner> <max corner>                                          2d only
+//   circle <center> <radius>                                                2d only
+//   box <center> <half extents>                                             2d only
+scene_description parse_scene(std::string_view text, const std::string& source_name)
+{
+    scene_description scene;
+    bool has_vectors = false;
+    std::vector<std::string_view> tokens;
+    size_t line_number = 0;
+    while (!text.empty())
+    {
+        const size_t line_end = text.find('\n');
+        std::string_view line = text.substr(0, line_end);
+        text.remove_prefix(line_end == std::string_view::npos ? text.size() : line_end + 1);
+        line_number++;
+        line = line.substr(0, line.find('#'));
+
+        tokens.clear();
+        while (true)
+        {
+            const size_t token_start = line.find_first_not_of(" \t\r");
+            if (token_start == std::string_view::npos)
+            {
+                break;
+            }
+            line.remove_prefix(token_start);
+            const size_t token_end = std::min(line.find_first_of(" \t\r"), line.size());
+            tokens.push_back(line.substr(0, token_end));
+            line.remove_prefix(token_end);
+        }
+        if (tokens.empty())
+        {
+            continue;
+        }
+
+        auto fail = [&](const std::string& message)
+        {
+            throw std::runtime_error(source_name + ":" + std::to_string(line_number) + ": " + message);
+        };
+        const std::string_view keyword = tokens[0];
+        // every keyword takes a fixed number of numbers after it
+        size_t next_token = 1;
+        auto expect_values = [&](size_t count)
+        {
+            if (tokens.size() != count + 1)
+            {
+                fail(std::string(keyword) + " expects " + std::to_string(count) + " values");
+            }
+        };
+        auto parse_number = [&](auto& value)
+        {
+            const std::string_view token = tokens[next_token++];
+            auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), value);
+            if (error != std::errc() || end != token.data() + token.size())
+            {
+                fail("invalid number '" + std::string(token) + "'");
+            }
+            return value;
+        };
+        auto read_float = [&]()
+        {
+            float value = 0;
+            return parse_number(value);
+        };
+        auto read_uint = [&]()
+        {
+            uint32_t value = 0;
+            return parse_number(value);
+        };
+        auto read_vector = [&]()
+        {
+            has_vectors = true;
+            glm::vec4 value(0, 0, 0, 0);
+            for (uint32_t component = 0; component < scene.dimensions; component++)
+            {
+                value[component] = read_float();
+            }
+            return value;
+        };
+        auto validate = [&]()
+        {
+            try
+            {
+                validate_parameters(scene.time_step, scene.particle_mass, scene.rest_density, scene.domain_min, scene.domain_max, scene.dimensions);
+            }
+            catch (const std::runtime_error& e)
+            {
+                fail(e.what());
+            }
+        };
+        auto require_2d = [&]()
+        {
+            if (scene.dimensions != 2)
+            {
+                fail(std::string(keyword) + " is only supported in 2d scenes");
+            }
+        };
+
+        if (keyword == "dimensions")
+        {
+            expect_values(1);
+            if (has_vectors)
+            {
+                fail("dimensions must come before any vector");
+            }
+            scene.dimensions = read_uint();
+            if (scene.dimensions != 2 && scene.dimensions != 3)
+            {
+                fail("dimensions must be 2 or 3");
+            }
+        }
+        else if (keyword == "solver")
+        {
+            expect_values(1);
+            if (tokens[1] == "sph")
+            {
+                scene.solver = solver_type::sph;
+            }
+            else if (tokens[1] == "pcisph")
+            {
+                scene.solver = solver_type::pcisph;
+            }
+            else if (tokens[1] == "pbf")
+            {
+                scene.solver = solver_type::pbf;
+            }
+            else
+            {
+                fail("unknown solver '" + std::string(tokens[1]) + "'");
+            }
+        }
+        else if (keyword == "time_step")
+        {
+            expect_values(1);
+            scene.time_step = read_float();
+            validate();
+        }
+        else if (keyword == "gravity")
+        {
+            expect_values(scene.dimensions);
+            scene.gravity = read_vector();
+        }
+        else if (keyword == "stiffness")
+        {
+            expect_values(1);
+            scene.stiffness = read_float();
+        }
+        else if (keyword == "viscosity")
+        {
+            expect_values(1);
+            scene.viscosity = read_float();
+        }
+        else if (keyword == "rest_density")
+        {
+            expect_values(1);
+            scene.rest_density = read_float();
+            validate();
+        }
+        else if (keyword == "mass")
+        {
+            expect_values(1);
+            scene.particle_mass = read_float();
+            validate();
+        }
+        else if (keyword == "domain")
+        {
+            expect_values(2 * scene.dimensions);
+            scene.domain_min = read_vector();
+            scene.domain_max = read_vector();
+            validate();
+        }
+        else if (keyword == "capacity")
+        {
+            expect_values(1);
+            scene.particle_capacity = read_uint();
+        }
+        else if (keyword == "block")
+        {
+            expect_values(2 * scene.dimensions);
+            fluid_block block {};
+            block.min_corner = read_vector();
+            block.count = glm::uvec4(1, 1, 1, scene.particle_count);
+            for (uint32_t component = 0; component < scene.dimensions; component++)
+            {
+                block.count[component] = read_uint();
+            }
+            const uint64_t block_particle_count = uint64_t(block.count.x) * block.count.y * block.count.z;
+            if (block_particle_count == 0 || scene.particle_count + block_particle_count > UINT32_MAX)
+            {
+                fail("block must hold between 1 and 2^32 - 1 particles");
+            }
+            scene.particle_count += static_cast<uint32_t>(block_particle_count);
+            scene.blocks.push_back(block);
+        }
+        else if (keyword == "emitter")
+        {
+            require_2d();
+            expect_values(2 * scene.dimensions + 2);
+            emitter e {};
+            e.position = read_vector();
+            e.velocity = read_vector();
+            e.particles_per_row = read_uint();
+            e.interval = read_uint();
+            if (e.particles_per_row == 0)
+            {
+                fail("emitter must spawn at least one particle per row");
+            }
+            // emit.comp takes the step number modulo the interval
+            if (e.interval == 0)
+            {
+                fail("emitter interval must be at least one step");
+            }
+            scene.emitters.push_back(e);
+        }
+        else if (keyword == "sink")
+        {
+            require_2d();
+            expect_values(2 * scene.dimensions);
+            sink s {};
+            s.min_corner = read_vector();
+            s.max_corner = read_vector();
+            for (uint32_t component = 0; component < scene.dimensions; component++)
+            {
+                if (s.min_corner[component] >= s.max_corner[component])
+                {
+                    fail("sink must be a non-empty box");
+                }
+            }
+            scene.sinks.push_back(s);
+        }
+        else if (keyword == "circle")
+        {
+            require_2d();
+            expect_values(3);
+            glm::vec4 center = read_vector();
+            scene.obstacles.push_back({ obstacle::shape::circle, glm::vec2(center.x, center.y), glm::vec2(read_float(), 0) });
+        }
+        else if (keyword == "box")
+        {
+            require_2d();
+            expect_values(4);
+            glm::vec4 center = read_vector();
+            glm::vec4 half_extent = read_vector();
+            scene.obstacles.push_back({ obstacle::shape::box, glm::vec2(center.x, center.y), glm::vec2(half_extent.x, half_extent.y) });
+        }
+        else
+        {
+            fail("unknown keyword '" + std::string(keyword) + "'");
+        }
+    }
+    if (scene.particle_count == 0 && scene.emitters.empty())
+    {
+        throw std::runtime_error(source_name + ": scene has neither fluid blocks nor emitters");
+    }
+    scene.particle_capacity = std::max(scene.particle_capacity, scene.particle_count);
+    return scene;
+}
+
+scene_description load_scene(const std::string& path)
+{
+    std::ifstream scene_file(path, std::ios::ate | std::ios::binary);
+    if (!scene_file)
+    {
+        throw std::runtime_error("scene file load error: " + path);
+    }
+    std::string text(static_cast<size_t>(scene_file.tellg()), '\0');
+    scene_file.seekg(0);
+    scene_file.read(text.data(), text.size());
+    return parse_scene(text, path);
+}
+
+scene_description default_scene(int64_t scene_id, bool three_dimensional)
+{
+    if (three_dimensional)
+    {
+        // the channel needs emitters and sinks, which are 2d only
+        const size_t index = std::min<size_t>(static_cast<size_t>(scene_id), std::size(default_scene_3d_text) - 1);
+        return parse_scene(default_scene_3d_text[index], "built-in 3d scene " + std::to_string(index));
+    }
+    const size_t index = std::min<size_t>(static_cast<size_t>(scene_id), std::size(default_scene_text) - 1);
+    return parse_scene(default_scene_text[index], "built-in scene " + std::to_string(index));
+}
+
+} // namespace sph
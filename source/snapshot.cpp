@@ -0,0 +1,430 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "snapshot.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace sph
+{
+
+namespace
+{
+
+// legacy vtk files are big endian
+void store_big_endian(char* destination, uint32_t bits)
+{
+    destination[0] = static_cast<char>(bits >> 24);
+    destination[1] = static_cast<char>(bits >> 16);
+    destination[2] = static_cast<char>(bits >> 8);
+    destination[3] = static_cast<char>(bits);
+}
+
+void store_big_endian(char* destination, float value)
+{
+    uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    store_big_endian(destination, bits);
+}
+
+uint32_t chunk_count(uint32_t particle_count)
+{
+    return std::max((particle_count + SPH_SNAPSHOT_CHUNK - 1) / SPH_SNAPSHOT_CHUNK, 1u);
+}
+
+} // namespace
+
+snapshot_exporter::~snapshot_exporter()
+{
+    finish();
+}
+
+void snapshot_exporter::start(const std::string& path, const snapshot_source& source, bool delay_when_busy)
+{
+    const size_t dot = path.find_last_of('.');
+    const std::string extension = dot == std::string::npos ? std::string() : path.substr(dot);
+    if (extension == ".vtk")
+    {
+        format = file_format::vtk;
+    }
+    else if (extension == ".csv")
+    {
+        format = file_format::csv;
+    }
+    else if (extension == ".bin")
+    {
+        format = file_format::binary;
+    }
+    else
+    {
+        throw std::runtime_error("snapshot path " + path + " needs a .vtk, .csv or .bin extension");
+    }
+    path_prefix = path.substr(0, dot);
+    path_suffix = extension;
+    this->source = source;
+    delay = delay_when_busy;
+
+    // the count is padded to a vector, the arrays keep the layout of the particle buffer
+    const GLsizeiptr vector_size = GLsizeiptr(source.dimensions == 3 ? 4 : 2) * sizeof(float) * source.particle_capacity;
+    const GLsizeiptr scalar_size = GLsizeiptr(sizeof(float)) * source.particle_capacity;
+    slot_position_offset = 16;
+    slot_velocity_offset = slot_position_offset + vector_size;
+    slot_density_offset = slot_velocity_offset + vector_size;
+    slot_pressure_offset = slot_density_offset + scalar_size;
+    const GLsizeiptr slot_size = slot_pressure_offset + scalar_size;
+    constexpr GLbitfield map_flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    for (slot& s : slots)
+    {
+        glCreateBuffers(1, &s.buffer);
+        glNamedBufferStorage(s.buffer, slot_size, nullptr, map_flags);
+        s.data = static_cast<const uint8_t*>(glMapNamedBufferRange(s.buffer, 0, slot_size, map_flags));
+    }
+
+    const uint32_t writer_count = std::clamp(std::thread::hardware_concurrency() / 2, 1u, static_cast<uint32_t>(SPH_SNAPSHOT_MAX_WRITERS));
+    stopping = false;
+    for (uint32_t i = 0; i < writer_count; i++)
+    {
+        writers.emplace_back(&snapshot_exporter::run_writer, this);
+    }
+    is_active = true;
+    log_message(log_level::info, "writing snapshots to %s_*%s with %u writer threads, %s when busy", path_prefix.c_str(), path_suffix.c_str(),
+        writer_count, delay ? "delayed" : "dropped");
+}
+
+void snapshot_exporter::finish()
+{
+    if (!is_active)
+    {
+        return;
+    }
+    // the copies may come from another context, wait on their fences instead of glFinish
+    while (!copying.empty())
+    {
+        glClientWaitSync(slots[copying.front()].fence, 0, GL_TIMEOUT_IGNORED);
+        poll();
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_changed.notify_all();
+    for (auto& writer : writers)
+    {
+        writer.join();
+    }
+    writers.clear();
+    for (slot& s : slots)
+    {
+        glDeleteBuffers(1, &s.buffer);
+        s = slot {};
+    }
+    is_active = false;
+    log_message(log_level::info, "wrote %llu snapshots, %llu dropped, %llu requests delayed", static_cast<unsigned long long>(written),
+        static_cast<unsigned long long>(dropped), static_cast<unsigned long long>(delayed));
+}
+
+bool snapshot_exporter::active() const
+{
+    return is_active;
+}
+
+bool snapshot_exporter::request(uint64_t step, double time)
+{
+    uint32_t index = 0;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        while (index < SPH_SNAPSHOT_SLOTS && slots[index].busy)
+        {
+            index++;
+        }
+        if (index == SPH_SNAPSHOT_SLOTS)
+        {
+            // back pressure, the writers are behind. the solver never waits for them
+            if (delay)
+            {
+                delayed++;
+                return false;
+            }
+            dropped++;
+            return true;
+        }
+        slots[index].busy = true;
+    }
+
+    slot& s = slots[index];
+    s.step = step;
+    s.time = time;
+    const GLsizeiptr vector_size = GLsizeiptr(source.dimensions == 3 ? 4 : 2) * sizeof(float) * source.particle_capacity;
+    const GLsizeiptr scalar_size = GLsizeiptr(sizeof(float)) * source.particle_capacity;
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glCopyNamedBufferSubData(source.state_buffer, s.buffer, source.count_offset, 0, sizeof(uint32_t));
+    glCopyNamedBufferSubData(source.particle_buffer, s.buffer, source.position_offset, slot_position_offset, vector_size);
+    glCopyNamedBufferSubData(source.particle_buffer, s.buffer, source.velocity_offset, slot_velocity_offset, vector_size);
+    glCopyNamedBufferSubData(source.particle_buffer, s.buffer, source.density_offset, slot_density_offset, scalar_size);
+    glCopyNamedBufferSubData(source.particle_buffer, s.buffer, source.pressure_offset, slot_pressure_offset, scalar_size);
+    s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // nothing else may flush the fence before the next poll
+    glFlush();
+    copying.push_back(index);
+    return true;
+}
+
+void snapshot_exporter::poll()
+{
+    // copies complete in order, so stop at the first one still in flight
+    while (!copying.empty())
+    {
+        slot& s = slots[copying.front()];
+        const GLenum wait_result = glClientWaitSync(s.fence, 0, 0);
+        if (wait_result != GL_ALREADY_SIGNALED && wait_result != GL_CONDITION_SATISFIED)
+        {
+            break;
+        }
+        glDeleteSync(s.fence);
+        s.fence = nullptr;
+        uint32_t particle_count = 0;
+        std::memcpy(&particle_count, s.data, sizeof(particle_count));
+        s.particle_count = std::min(particle_count, source.particle_capacity);
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            tasks.push_back({ copying.front(), UINT32_MAX });
+        }
+        queue_changed.notify_one();
+        copying.pop_front();
+    }
+}
+
+void snapshot_exporter::run_writer()
+{
+    while (true)
+    {
+        task next {};
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_changed.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+            {
+                return;
+            }
+            next = tasks.front();
+            tasks.pop_front();
+        }
+        slot& s = slots[next.slot_index];
+        if (next.chunk == UINT32_MAX)
+        {
+            // the chunks go to the front, a snapshot is finished before the next one is started
+            lay_out(s);
+            const uint32_t chunks = chunk_count(s.particle_count);
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                s.chunks_left = chunks;
+                for (uint32_t chunk = chunks; chunk > 0; chunk--)
+                {
+                    tasks.push_front({ next.slot_index, chunk - 1 });
+                }
+            }
+            queue_changed.notify_all();
+            continue;
+        }
+        format_chunk(s, next.chunk);
+        bool last = false;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            last = --s.chunks_left == 0;
+        }
+        if (!last)
+        {
+            continue;
+        }
+        write_file(s);
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        s.busy = false;
+        written++;
+    }
+}
+
+void snapshot_exporter::lay_out(slot& s)
+{
+    const size_t n = s.particle_count;
+    const size_t dimensions = source.dimensions;
+    if (format == file_format::csv)
+    {
+        s.chunk_text.resize(chunk_count(s.particle_count));
+        return;
+    }
+    std::array<std::string, 6> text;
+    std::array<size_t, 5> section_size {};
+    if (format == file_format::vtk)
+    {
+        // points are always 3d, the vertices make every point a cell so viewers draw them
+        char line[128];
+        std::snprintf(line, sizeof(line), "sph step %llu time %.9g\n", static_cast<unsigned long long>(s.step), s.time);
+        text[0] = std::string("# vtk DataFile Version 3.0\n") + line + "BINARY\nDATASET POLYDATA\nPOINTS " + std::to_string(n) + " float\n";
+        text[1] = "\nVERTICES " + std::to_string(n) + " " + std::to_string(2 * n) + "\n";
+        text[2] = "\nPOINT_DATA " + std::to_string(n) + "\nVECTORS velocity float\n";
+        text[3] = "\nSCALARS density float 1\nLOOKUP_TABLE default\n";
+        text[4] = "\nSCALARS pressure float 1\nLOOKUP_TABLE default\n";
+        text[5] = "\n";
+        section_size = { 12 * n, 8 * n, 12 * n, 4 * n, 4 * n };
+    }
+    else
+    {
+        // structure of arrays, described by the sidecar
+        section_size = { 4 * dimensions * n, 4 * dimensions * n, 4 * n, 4 * n };
+    }
+    size_t size = 0;
+    for (size_t section = 0; section < section_size.size(); section++)
+    {
+        size += text[section].size();
+        s.section_offset[section] = size;
+        size += section_size[section];
+    }
+    size += text[5].size();
+    s.contents.resize(size);
+    for (size_t section = 0; section < text.size(); section++)
+    {
+        const size_t end = section < section_size.size() ? s.section_offset[section] : size;
+        std::memcpy(s.contents.data() + end - text[section].size(), text[section].data(), text[section].size());
+    }
+}
+
+void snapshot_exporter::format_chunk(slot& s, uint32_t chunk) const
+{
+    const uint32_t first = chunk * SPH_SNAPSHOT_CHUNK;
+    const uint32_t end = std::min(first + SPH_SNAPSHOT_CHUNK, s.particle_count);
+    const uint32_t dimensions = source.dimensions;
+    const uint32_t stride = dimensions == 3 ? 4 : 2;
+    const float* position = array(s, slot_position_offset);
+    const float* velocity = array(s, slot_velocity_offset);
+    const float* density = array(s, slot_density_offset);
+    const float* pressure = array(s, slot_pressure_offset);
+    if (format == file_format::csv)
+    {
+        std::string& text = s.chunk_text[chunk];
+        text.clear();
+        char row[256];
+        for (uint32_t i = first; i < end; i++)
+        {
+            const float* p = position + stride * i;
+            const float* v = velocity + stride * i;
+            const int length = dimensions == 3
+                ? std::snprintf(row, sizeof(row), "%.7g,%.7g,%.7g,%.7g,%.7g,%.7g,%.7g,%.7g\n", p[0], p[1], p[2], v[0], v[1], v[2], density[i], pressure[i])
+                : std::snprintf(row, sizeof(row), "%.7g,%.7g,%.7g,%.7g,%.7g,%.7g\n", p[0], p[1], v[0], v[1], density[i], pressure[i]);
+            text.append(row, length);
+        }
+        return;
+    }
+    char* contents = s.contents.data();
+    if (format == file_format::vtk)
+    {
+        for (uint32_t i = first; i < end; i++)
+        {
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                store_big_endian(contents + s.section_offset[0] + 12 * size_t(i) + 4 * c, c < dimensions ? position[stride * i + c] : 0.f);
+                store_big_endian(contents + s.section_offset[2] + 12 * size_t(i) + 4 * c, c < dimensions ? velocity[stride * i + c] : 0.f);
+            }
+            store_big_endian(contents + s.section_offset[1] + 8 * size_t(i), 1u);
+            store_big_endian(contents + s.section_offset[1] + 8 * size_t(i) + 4, i);
+            store_big_endian(contents + s.section_offset[3] + 4 * size_t(i), density[i]);
+            store_big_endian(contents + s.section_offset[4] + 4 * size_t(i), pressure[i]);
+        }
+        return;
+    }
+    // 3d vectors drop the padding
+    for (uint32_t i = first; i < end; i++)
+    {
+        std::memcpy(contents + s.section_offset[0] + 4 * size_t(dimensions) * i, position + stride * i, 4 * dimensions);
+        std::memcpy(contents + s.section_offset[1] + 4 * size_t(dimensions) * i, velocity + stride * i, 4 * dimensions);
+    }
+    std::memcpy(contents + s.section_offset[2] + 4 * size_t(first), density + first, 4 * size_t(end - first));
+    std::memcpy(contents + s.section_offset[3] + 4 * size_t(first), pressure + first, 4 * size_t(end - first));
+}
+
+void snapshot_exporter::write_file(slot& s) const
+{
+    const std::string path = snapshot_path(s.step);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (format == file_format::csv)
+    {
+        file << (source.dimensions == 3 ? "x,y,z,vx,vy,vz,density,pressure\n" : "x,y,vx,vy,density,pressure\n");
+        for (const std::string& text : s.chunk_text)
+        {
+            file << text;
+        }
+    }
+    else
+    {
+        file.write(s.contents.data(), s.contents.size());
+    }
+    if (!file)
+    {
+        log_message(log_level::warning, "cannot write %s", path.c_str());
+        return;
+    }
+    if (format != file_format::binary)
+    {
+        return;
+    }
+
+    // the sidecar names the arrays of the raw file
+    const size_t name_start = path.find_last_of("/\\");
+    const std::string name = name_start == std::string::npos ? path : path.substr(name_start + 1);
+    const std::string sidecar_path = path.substr(0, path.size() - path_suffix.size()) + ".json";
+    const size_t n = s.particle_count;
+    const char* array_names[] = { "position", "velocity", "density", "pressure" };
+    const size_t components[] = { source.dimensions, source.dimensions, 1, 1 };
+    char text[256];
+    std::snprintf(text, sizeof(text), "{\n  \"file\": \"%s\",\n  \"step\": %llu,\n  \"time\": %.9g,\n  \"particle_count\": %zu,\n  \"dimensions\": %u,\n",
+        name.c_str(), static_cast<unsigned long long>(s.step), s.time, n, source.dimensions);
+    std::ofstream sidecar(sidecar_path, std::ios::trunc);
+    sidecar << text << "  \"arrays\": [\n";
+    for (size_t a = 0; a < 4; a++)
+    {
+        std::snprintf(text, sizeof(text), "    { \"name\": \"%s\", \"type\": \"float32\", \"components\": %zu, \"offset\": %zu, \"bytes\": %zu }%s\n",
+            array_names[a], components[a], s.section_offset[a], 4 * components[a] * n, a + 1 < 4 ? "," : "");
+        sidecar << text;
+    }
+    sidecar << "  ]\n}\n";
+    if (!sidecar)
+    {
+        log_message(log_level::warning, "cannot write %s", sidecar_path.c_str());
+    }
+}
+
+std::string snapshot_exporter::snapshot_path(uint64_t step) const
+{
+    char number[32];
+    std::snprintf(number, sizeof(number), "_%06llu", static_cast<unsigned long long>(step));
+    return path_prefix + number + path_suffix;
+}
+
+const float* snapshot_exporter::array(const slot& s, GLintptr offset) const
+{
+    return reinterpret_cast<const float*>(s.data + offset);
+}
+
+} // namespace sph
@@ -0,0 +1,177 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "sph.h"
+#include "application.hpp"
+
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+struct sph_context
+{
+    sph::application_options options;
+    std::unique_ptr<sph::application> app;
+    double step_seconds = 0;
+    std::string error;
+};
+
+namespace
+{
+
+// runs f and turns an exception into the error of the context
+template <typename function>
+int guarded(sph_context* context, function f)
+{
+    if (context == nullptr)
+    {
+        return -1;
+    }
+    try
+    {
+        f();
+        context->error.clear();
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        context->error = e.what();
+        return -1;
+    }
+}
+
+void load(sph_context* context)
+{
+    // the old context goes first, without EGL only one glfw window set can exist
+    context->app.reset();
+    context->app = std::make_unique<sph::application>(context->options);
+    context->step_seconds = 0;
+}
+
+sph::application& loaded(sph_context* context)
+{
+    if (!context->app)
+    {
+        throw std::runtime_error("no scene is loaded");
+    }
+    return *context->app;
+}
+
+} // namespace
+
+sph_context* sph_create(const char* shader_directory)
+{
+    sph_context* context = new (std::nothrow) sph_context;
+    if (context == nullptr)
+    {
+        return nullptr;
+    }
+    context->options.windowless = true;
+    context->options.simulation_thread = false;
+    context->options.stats = sph::stats_output::none;
+    if (shader_directory != nullptr)
+    {
+        context->options.shader_directory = shader_directory;
+        if (!context->options.shader_directory.empty() && context->options.shader_directory.back() != '/' && context->options.shader_directory.back() != '\\')
+        {
+            context->options.shader_directory += '/';
+        }
+    }
+    return context;
+}
+
+int sph_load_scene(sph_context* context, const char* path)
+{
+    return guarded(context, [context, path]
+    {
+        if (path == nullptr || *path == '\0')
+        {
+            throw std::runtime_error("no scene path");
+        }
+        context->options.scene_path = path;
+        load(context);
+    });
+}
+
+int sph_load_builtin_scene(sph_context* context, int scene_id, int three_dimensional)
+{
+    return guarded(context, [context, scene_id, three_dimensional]
+    {
+        context->options.scene_path.clear();
+        context->options.scene_id = scene_id;
+        context->options.three_dimensional = three_dimensional != 0;
+        load(context);
+    });
+}
+
+int sph_step(sph_context* context, uint32_t count)
+{
+    return guarded(context, [context, count]
+    {
+        sph::application& app = loaded(context);
+        const auto start = std::chrono::steady_clock::now();
+        app.step(count);
+        app.synchronize();
+        context->step_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    });
+}
+
+int sph_get_stats(sph_context* context, sph_stats* stats)
+{
+    return guarded(context, [context, stats]
+    {
+        const sph::application& app = loaded(context);
+        if (stats == nullptr)
+        {
+            throw std::runtime_error("no stats to fill in");
+        }
+        stats->steps = app.step_count();
+        stats->simulated_seconds = app.simulated_time();
+        stats->step_seconds = context->step_seconds;
+        stats->particle_count = app.particle_count();
+        stats->particle_capacity = app.capacity();
+        stats->dimensions = app.dimensions();
+    });
+}
+
+int sph_export(sph_context* context, const char* path)
+{
+    return guarded(context, [context, path]
+    {
+        if (path == nullptr)
+        {
+            throw std::runtime_error("no export path");
+        }
+        loaded(context).export_particles(path);
+    });
+}
+
+const char* sph_last_error(const sph_context* context)
+{
+    return context != nullptr ? context->error.c_str() : "no context";
+}
+
+void sph_destroy(sph_context* context)
+{
+    delete context;
+}
@@ -0,0 +1,277 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace sph
+{
+
+const char* stage_name(frame_stage stage)
+{
+    switch (stage)
+    {
+    case frame_stage::simulation:
+        return "simulation";
+    case frame_stage::render:
+        return "render";
+    case frame_stage::grid:
+        return "grid";
+    case frame_stage::density:
+        return "density";
+    case frame_stage::force:
+        return "force";
+    case frame_stage::pressure:
+        return "pressure";
+    case frame_stage::integrate:
+        return "integrate";
+    case frame_stage::particle_count:
+        return "particle_count";
+    default:
+        return "?";
+    }
+}
+
+uint32_t rolling_histogram::bin_of(float milliseconds)
+{
+    if (!(milliseconds > SPH_STATS_MIN_MS))
+    {
+        return 0;
+    }
+    const float bin = std::log2(milliseconds / SPH_STATS_MIN_MS) * SPH_STATS_BINS_PER_OCTAVE;
+    return std::min(static_cast<uint32_t>(bin), static_cast<uint32_t>(SPH_STATS_BINS - 1));
+}
+
+void rolling_histogram::add(float milliseconds)
+{
+    if (sample_count == SPH_STATS_WINDOW)
+    {
+        const float evicted = samples[next_sample];
+        bins[bin_of(evicted)]--;
+        sum -= evicted;
+    }
+    else
+    {
+        sample_count++;
+    }
+    samples[next_sample] = milliseconds;
+    bins[bin_of(milliseconds)]++;
+    sum += milliseconds;
+    next_sample = (next_sample + 1) % SPH_STATS_WINDOW;
+}
+
+uint32_t rolling_histogram::count() const
+{
+    return sample_count;
+}
+
+float rolling_histogram::mean() const
+{
+    return sample_count > 0 ? static_cast<float>(sum / sample_count) : 0.f;
+}
+
+float rolling_histogram::max() const
+{
+    float largest = 0;
+    for (uint32_t i = 0; i < sample_count; i++)
+    {
+        largest = std::max(largest, samples[i]);
+    }
+    return largest;
+}
+
+float rolling_histogram::percentile(float fraction) const
+{
+    if (sample_count == 0)
+    {
+        return 0;
+    }
+    const uint32_t rank = static_cast<uint32_t>(std::ceil(fraction * sample_count));
+    uint32_t seen = 0;
+    uint32_t bin = 0;
+    for (; bin < SPH_STATS_BINS - 1; bin++)
+    {
+        seen += bins[bin];
+        if (seen >= std::max(rank, 1u))
+        {
+            break;
+        }
+    }
+    const float center = SPH_STATS_MIN_MS * std::exp2((bin + 0.5f) / SPH_STATS_BINS_PER_OCTAVE);
+    // the top bin is open ended
+    return std::min(center, max());
+}
+
+void frame_stats::initialize(float publish_interval_seconds)
+{
+    glGenQueries(SPH_STATS_QUERY_LATENCY * stage_count * 2, &queries[0][0][0]);
+    publish_interval = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(publish_interval_seconds));
+    last_publish = clock::now();
+    std::memset(overlay_chars.data(), ' ', overlay_chars.size() - 1);
+}
+
+void frame_stats::destroy()
+{
+    glDeleteQueries(SPH_STATS_QUERY_LATENCY * stage_count * 2, &queries[0][0][0]);
+    // query names belong to the context that made them, a second destroy from another context must not free its names
+    std::memset(queries, 0, sizeof(queries));
+}
+
+void frame_stats::begin_frame()
+{
+    frame_start = clock::now();
+    // the queries of this slot were issued SPH_STATS_QUERY_LATENCY frames ago
+    const uint32_t slot = frame_index % SPH_STATS_QUERY_LATENCY;
+    read_back_gpu.fill(-1);
+    read_queries(slot);
+    read_back_steps = query_steps[slot];
+    query_steps[slot] = 0;
+}
+
+void frame_stats::read_queries(uint32_t slot)
+{
+    for (uint32_t stage = 0; stage < stage_count; stage++)
+    {
+        if (!query_issued[slot][stage])
+        {
+            continue;
+        }
+        GLint available = 0;
+        glGetQueryObjectiv(queries[slot][stage][1], GL_QUERY_RESULT_AVAILABLE, &available);
+        // a result still in flight is dropped rather than waited for, the queries are issued again this frame
+        if (available)
+        {
+            GLuint64 begin_ns = 0;
+            GLuint64 end_ns = 0;
+            glGetQueryObjectui64v(queries[slot][stage][0], GL_QUERY_RESULT, &begin_ns);
+            glGetQueryObjectui64v(queries[slot][stage][1], GL_QUERY_RESULT, &end_ns);
+            read_back_gpu[stage] = 1e-6f * (end_ns - begin_ns);
+            stage_gpu[stage].add(read_back_gpu[stage]);
+        }
+        query_issued[slot][stage] = false;
+    }
+}
+
+void frame_stats::begin_stage(frame_stage stage)
+{
+    const uint32_t s = static_cast<uint32_t>(stage);
+    stage_start[s] = clock::now();
+    glQueryCounter(queries[frame_index % SPH_STATS_QUERY_LATENCY][s][0], GL_TIMESTAMP);
+}
+
+void frame_stats::end_stage(frame_stage stage)
+{
+    const uint32_t s = static_cast<uint32_t>(stage);
+    glQueryCounter(queries[frame_index % SPH_STATS_QUERY_LATENCY][s][1], GL_TIMESTAMP);
+    query_issued[frame_index % SPH_STATS_QUERY_LATENCY][s] = true;
+    stage_cpu[s].add(std::chrono::duration<float, std::milli>(clock::now() - stage_start[s]).count());
+}
+
+bool frame_stats::end_frame()
+{
+    const clock::time_point frame_end = clock::now();
+    frame_cpu.add(std::chrono::duration<float, std::milli>(frame_end - frame_start).count());
+    frame_index++;
+    if (frame_end - last_publish < publish_interval)
+    {
+        return false;
+    }
+    last_publish = frame_end;
+    format();
+    return true;
+}
+
+void frame_stats::add_step()
+{
+    query_steps[frame_index % SPH_STATS_QUERY_LATENCY]++;
+}
+
+bool frame_stats::read_back(frame_stage stage, float& milliseconds, uint32_t& steps) const
+{
+    milliseconds = read_back_gpu[static_cast<uint32_t>(stage)];
+    steps = read_back_steps;
+    return milliseconds >= 0;
+}
+
+// snprintf into the fixed buffers, nothing here allocates
+void frame_stats::format()
+{
+    const rolling_histogram& simulation_gpu = stage_gpu[static_cast<uint32_t>(frame_stage::simulation)];
+    const rolling_histogram& render_gpu = stage_gpu[static_cast<uint32_t>(frame_stage::render)];
+    int length = std::snprintf(summary_text.data(), summary_text.size(), "frame p50 %.3f ms p99 %.3f ms max %.3f ms",
+        frame_cpu.percentile(0.5f), frame_cpu.percentile(0.99f), frame_cpu.max());
+    // a stage without samples is left out, with a simulation thread each thread only times its own stages
+    for (frame_stage stage : { frame_stage::simulation, frame_stage::render })
+    {
+        const rolling_histogram& histogram = stage_gpu[static_cast<uint32_t>(stage)];
+        if (histogram.count() > 0 && length >= 0 && length < static_cast<int>(summary_text.size()))
+        {
+            length += std::snprintf(summary_text.data() + length, summary_text.size() - length, " | gpu %s p50 %.3f ms",
+                stage_name(stage), histogram.percentile(0.5f));
+        }
+    }
+
+    auto write_line = [this](uint32_t line, const char* label, const rolling_histogram& histogram)
+    {
+        char buffer[SPH_STATS_OVERLAY_COLUMNS + 1];
+        int length = std::snprintf(buffer, sizeof(buffer), "%-8s %7.3f %7.3f %7.3f %7.3f", label,
+            histogram.mean(), histogram.percentile(0.5f), histogram.percentile(0.99f), histogram.max());
+        length = std::clamp(length, 0, SPH_STATS_OVERLAY_COLUMNS);
+        char* destination = overlay_chars.data() + line * SPH_STATS_OVERLAY_COLUMNS;
+        std::memset(destination, ' ', SPH_STATS_OVERLAY_COLUMNS);
+        std::memcpy(destination, buffer, length);
+    };
+    // columns are mean, median, 99th percentile and maximum in milliseconds
+    write_line(0, "frame", frame_cpu);
+    write_line(1, "sim cpu", stage_cpu[static_cast<uint32_t>(frame_stage::simulation)]);
+    write_line(2, "sim gpu", simulation_gpu);
+    write_line(3, "draw gpu", render_gpu);
+}
+
+const char* frame_stats::summary() const
+{
+    return summary_text.data();
+}
+
+const char* frame_stats::overlay_text() const
+{
+    return overlay_chars.data();
+}
+
+const rolling_histogram& frame_stats::frame_histogram() const
+{
+    return frame_cpu;
+}
+
+const rolling_histogram& frame_stats::cpu_histogram(frame_stage stage) const
+{
+    return stage_cpu[static_cast<uint32_t>(stage)];
+}
+
+const rolling_histogram& frame_stats::gpu_histogram(frame_stage stage) const
+{
+    return stage_gpu[static_cast<uint32_t>(stage)];
+}
+
+} // namespace sph
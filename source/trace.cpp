@@ -0,0 +1,190 @@
+// Copyright (c) 2017-2018, Samuel Ivan Gunadi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "trace.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace sph
+{
+
+void trace_recorder::initialize(bool enable)
+{
+    is_enabled = enable;
+    origin = std::chrono::steady_clock::now();
+    if (!is_enabled)
+    {
+        return;
+    }
+    slots = std::make_unique<slot[]>(SPH_TRACE_CAPACITY);
+    gpu_spans.resize(SPH_TRACE_GPU_SPANS);
+    std::vector<GLuint> queries(2 * SPH_TRACE_GPU_SPANS);
+    glGenQueries(static_cast<GLsizei>(queries.size()), queries.data());
+    for (uint32_t span = 0; span < SPH_TRACE_GPU_SPANS; span++)
+    {
+        gpu_spans[span].begin_query = queries[2 * span];
+        gpu_spans[span].end_query = queries[2 * span + 1];
+    }
+    // the gpu clock has its own origin, line it up with the cpu clock
+    GLint64 gpu_now = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+    gpu_clock_offset_ns = now_ns() - gpu_now;
+}
+
+void trace_recorder::destroy()
+{
+    for (const auto& span : gpu_spans)
+    {
+        glDeleteQueries(1, &span.begin_query);
+        glDeleteQueries(1, &span.end_query);
+    }
+    gpu_spans.clear();
+}
+
+int64_t trace_recorder::now_ns() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+uint32_t trace_recorder::current_track()
+{
+    static std::atomic<uint32_t> next_track { 1 };
+    thread_local uint32_t track = next_track.fetch_add(1, std::memory_order_relaxed);
+    return track;
+}
+
+void trace_recorder::record(const char* name, int64_t begin_ns, int64_t end_ns, uint32_t track)
+{
+    const uint64_t index = next_slot.fetch_add(1, std::memory_order_relaxed);
+    slot& s = slots[index % SPH_TRACE_CAPACITY];
+    // readers skip a slot whose sequence is odd or changes while they copy it
+    s.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.name.store(name, std::memory_order_relaxed);
+    s.begin_ns.store(begin_ns, std::memory_order_relaxed);
+    s.end_ns.store(end_ns, std::memory_order_relaxed);
+    s.track.store(track, std::memory_order_relaxed);
+    s.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+uint32_t trace_recorder::begin_gpu_span(const char* name)
+{
+    if (next_gpu_span - oldest_gpu_span == SPH_TRACE_GPU_SPANS)
+    {
+        return SPH_TRACE_GPU_SPANS;
+    }
+    const uint32_t span = static_cast<uint32_t>(next_gpu_span++ % SPH_TRACE_GPU_SPANS);
+    gpu_spans[span].name = name;
+    glQueryCounter(gpu_spans[span].begin_query, GL_TIMESTAMP);
+    return span;
+}
+
+void trace_recorder::end_gpu_span(uint32_t span)
+{
+    if (span < SPH_TRACE_GPU_SPANS)
+    {
+        glQueryCounter(gpu_spans[span].end_query, GL_TIMESTAMP);
+    }
+}
+
+void trace_recorder::resolve_gpu_spans()
+{
+    if (!is_enabled)
+    {
+        return;
+    }
+    // queries complete in issue order, so stop at the first one still in flight
+    while (oldest_gpu_span != next_gpu_span)
+    {
+        const gpu_span& span = gpu_spans[oldest_gpu_span % SPH_TRACE_GPU_SPANS];
+        GLint available = 0;
+        glGetQueryObjectiv(span.end_query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            break;
+        }
+        GLuint64 begin_ns = 0;
+        GLuint64 end_ns = 0;
+        glGetQueryObjectui64v(span.begin_query, GL_QUERY_RESULT, &begin_ns);
+        glGetQueryObjectui64v(span.end_query, GL_QUERY_RESULT, &end_ns);
+        record(span.name, static_cast<int64_t>(begin_ns) + gpu_clock_offset_ns, static_cast<int64_t>(end_ns) + gpu_clock_offset_ns, 0);
+        oldest_gpu_span++;
+    }
+}
+
+void trace_recorder::write(const std::string& path) const
+{
+    if (!is_enabled)
+    {
+        return;
+    }
+    std::vector<trace_event> events;
+    events.reserve(SPH_TRACE_CAPACITY);
+    uint32_t track_count = 1;
+    for (uint32_t i = 0; i < SPH_TRACE_CAPACITY; i++)
+    {
+        const slot& s = slots[i];
+        const uint64_t sequence = s.sequence.load(std::memory_order_acquire);
+        if (sequence == 0 || sequence % 2 == 1)
+        {
+            continue;
+        }
+        const trace_event event { s.name.load(std::memory_order_relaxed), s.begin_ns.load(std::memory_order_relaxed),
+            s.end_ns.load(std::memory_order_relaxed), s.track.load(std::memory_order_relaxed) };
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.sequence.load(std::memory_order_relaxed) != sequence)
+        {
+            continue;
+        }
+        events.push_back(event);
+        track_count = std::max(track_count, event.track + 1);
+    }
+    std::sort(events.begin(), events.end(), [](const trace_event& a, const trace_event& b) { return a.begin_ns < b.begin_ns; });
+
+    std::ofstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("trace file open error");
+    }
+    // complete events ("X") with microsecond timestamps, one thread per track
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"sph\"}}";
+    for (uint32_t track = 0; track < track_count; track++)
+    {
+        file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track << ",\"args\":{\"name\":\""
+            << (track == 0 ? "gpu" : "cpu ") << (track == 0 ? "" : std::to_string(track)) << "\"}}";
+    }
+    file.setf(std::ios_base::fixed, std::ios_base::floatfield);
+    file.precision(3);
+    for (const auto& event : events)
+    {
+        file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.track
+            << ",\"ts\":" << 1e-3 * event.begin_ns << ",\"dur\":" << 1e-3 * (event.end_ns - event.begin_ns) << "}";
+    }
+    file << "\n]}\n";
+    if (!file)
+    {
+        throw std::runtime_error("trace file write error");
+    }
+}
+
+} // namespace sph